@@ -7,27 +7,128 @@
 //
 
 #include "BasicSolvingSystem.h"
+#include "FormatBuffer.h"
+#include <chrono>
 
 using namespace std;
 
+void BasicSolvingSystem::beginStaging()
+{
+    if (prob -> parameters.stagingMB <= 0)
+        return;
+    delete staging;
+    staging = new OutOfCoreMatrix(prob -> parameters.meshFilename + ".stage", prob -> parameters.stagingMB << 20);
+}
+
+// the solver of choice, for the staged file in out-of-core assembly and for ma otherwise
+LinearSolver *BasicSolvingSystem::newSolver(SolverChoice choice, const std::string &stagedFile)
+{
+    LinearSolver *s;
+    if (choice == SolverChoice::UMFPACK)
+    {
+        if (prob -> parameters.mixedPrecision)
+            cout << "UMFPACK has no single precision, factoring in double" << endl;
+        s = stagedFile.empty() ? new UMFPACKSolver(ma, dof, rh) : new UMFPACKSolver(stagedFile, dof, rh);
+    }
+    else
+    {
+        SuperLUSolver *superlu = stagedFile.empty() ? new SuperLUSolver(ma, dof, rh) : new SuperLUSolver(stagedFile, dof, rh);
+        superlu -> setNaturalOrdering(choice == SolverChoice::SuperLUNatural);
+        superlu -> setMixedPrecision(prob -> parameters.mixedPrecision != 0);
+        s = superlu;
+    }
+    s -> setKeepFactorization(keepFactorization);
+    s -> setPrintStatistics(prob -> parameters.solverStats != 0);
+    return s;
+}
+
+// without a cached decision for a similar size every candidate solves once and the fastest
+// is kept as solver, with its solution in x; true if the system was solved
+bool BasicSolvingSystem::autotuneSolver(const std::string &stagedFile)
+{
+    SolverTuner tuner(prob -> parameters.meshFilename);
+    SolverChoice choice = SolverChoice::UMFPACK;
+    if (tuner.lookup(dof, choice))
+    {
+        cout << "autotune: " << SolverTuner::name(choice) << ", cached in " << tuner.cacheFile() << endl;
+        RunReport::setValue("autotune_choice", static_cast<int>(choice));
+        solver = newSolver(choice, stagedFile);
+        return false;
+    }
+
+    vector<double> seconds;
+    for (int c = 0; c < static_cast<int>(SolverChoice::Count); c++)
+    {
+        LinearSolver *candidate = newSolver(static_cast<SolverChoice>(c), stagedFile);
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        vector<double> solution = candidate -> solveSparse();
+        seconds.push_back(chrono::duration<double>(chrono::steady_clock::now() - start).count());
+        cout << "autotune: " << SolverTuner::name(static_cast<SolverChoice>(c)) << " " << seconds[c] << "s" << endl;
+        if (c == 0 || seconds[c] < seconds[static_cast<int>(choice)])
+        {
+            delete solver;
+            solver = candidate;
+            choice = static_cast<SolverChoice>(c);
+            x.swap(solution);
+        }
+        else
+            delete candidate;
+    }
+    tuner.record(dof, solver -> nonzeros(), choice, seconds);
+    cout << "autotune: " << SolverTuner::name(choice) << ", written to " << tuner.cacheFile() << endl;
+    RunReport::setValue("autotune_choice", static_cast<int>(choice));
+    RunReport::setValue("autotune_probed", 1);
+    solver -> reportStatistics(false); // those of the last candidate otherwise
+    return true;
+}
+
+// a staged matrix is merged on disk and mapped by a new solver, which then owns it
 void BasicSolvingSystem::solveSparse()
 {
-    LinearSolver *ls = nullptr;
-    if (prob -> parameters.solPack == SolPack::UMFPACK)
-        ls = new UMFPACKSolver(ma, dof, rh);
-    else if (prob -> parameters.solPack == SolPack::SuperLU)
-        ls = new SuperLUSolver(ma, dof, rh);
+    std::string stagedFile;
+    if (staging != nullptr)
+    {
+        delete solver;
+        solver = nullptr;
+        PhaseTimer timer(Phase::CSCConversion);
+        stagedFile = staging -> finish(dof);
+    }
+    // a solver for the same pattern keeps its CSC structure and symbolic factorization
+    else if (solver != nullptr && !solver -> updateValues(ma, dof, rh))
+    {
+        delete solver;
+        solver = nullptr;
+    }
 
-    if (ls != nullptr)
+    bool solved = false;
+    if (solver == nullptr)
     {
-        x = ls -> solveSparse();
-        delete ls;
+        if (prob -> parameters.solPack == SolPack::Auto)
+            solved = autotuneSolver(stagedFile);
+        else if (prob -> parameters.solPack == SolPack::UMFPACK)
+            solver = newSolver(SolverChoice::UMFPACK, stagedFile);
+        else if (prob -> parameters.solPack == SolPack::SuperLU)
+            solver = newSolver(SolverChoice::SuperLUNatural, stagedFile);
+    }
+    delete staging; // removes the files, the mapping stays
+    staging = nullptr;
+
+    if (solver != nullptr && !solved)
+    {
+        if (prob -> parameters.factorDir != "none")
+            solver -> setFactorDirectory(prob -> parameters.factorDir);
+        x = solver -> solveSparse();
     }
 }
 
 int BasicSolvingSystem::addToMA(double a, int row, int col)
 {
     if (a == 0) return 0;
+    if (staging != nullptr)
+    {
+        staging -> add(row, col, a);
+        return 0;
+    }
 
     maColEle *pmaColEle;
     std::list<maColEle>::iterator it;
@@ -50,46 +151,48 @@ int BasicSolvingSystem::addToMA(double a, int row, int col)
 
 int BasicSolvingSystem::fileOutputTriplet()
 {
+    if (prob->parameters.stagingMB > 0 && solver != nullptr)
+    {
+        solver -> writeTriplet(prob->parameters.meshFilename + ".triplet");
+        return 0;
+    }
     std::ofstream fout((prob->parameters.meshFilename + ".triplet").c_str());
+    FormatBuffer out(&fout);
 
     std::vector< std::list<maColEle> >::iterator it;
     std::list<maColEle>::iterator it1;
     int k;
     for (it = ma.begin(), k = 1; it != ma.end(); it++, k++)
         for (it1 = it -> begin(); it1 != it -> end(); it1++)
-            fout << ((it1 -> row) + 1) << " " << k << " " << (it1 -> value) << std::endl;
+            out << ((it1 -> row) + 1) << ' ' << k << ' ' << (it1 -> value) << '\n';
 
     return 0;
 }
 int BasicSolvingSystem::fileOutputRH()
 {
     std::ofstream fout((prob->parameters.meshFilename + ".rh").c_str());
+    FormatBuffer out(&fout);
 
     for (int i = 0; i < dof; i++)
-        fout << rh[i] << std::endl;
+        out << rh[i] << '\n';
 
     return 0;
 }
+// the CSC arrays of the solver of the last solve
 int BasicSolvingSystem::fileOutputMA()
 {
-    // std::ofstream fout((prob->parameters.meshFilename + ".ma").c_str());
-
-    // for (int i = 0; i < ma.size() + 1; i++)
-    //     fout << Ap[i] << " ";
-    // fout << std::endl;
-
-    // int nnz(0);
-    // for (std::vector< std::list<maColEle> >::iterator it = ma.begin();
-    //         it != ma.end(); it++)
-    //     nnz += it -> size();
-
-    // for (int i = 0; i < nnz; i++)
-    //     fout << Ai[i] << " ";
-    // fout << std::endl;
+    if (solver == nullptr) {
+        std::cout << "no CSC matrix to output, the system was not solved" << std::endl;
+        return 1;
+    }
 
-    // for (int i = 0; i < nnz; i++)
-    //     fout << Ax[i] << " ";
-    // fout << std::endl;
+    const std::string &base = prob->parameters.meshFilename;
+    if (prob->parameters.fprintMA == 2)
+        solver -> writeMatrixMarket(base + ".mtx");
+    else if (prob->parameters.fprintMA == 3)
+        solver -> writeBinaryCSC(base + ".csc");
+    else
+        solver -> writeCSC(base + ".ma");
 
     return 0;
 }
@@ -104,3 +207,8 @@ void BasicSolvingSystem::output()
         fileOutputTriplet();
 }
 
+void BasicSolvingSystem::report()
+{
+    if (prob->parameters.fprintReport)
+        RunReport::writeJSON(prob->parameters.meshFilename + ".report.json");
+}
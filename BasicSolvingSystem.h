@@ -17,6 +17,8 @@
 #include "UMFPACKSolver.h"
 #include "SuperLUSolver.h"
 #include "SuperLUDISTSolver.h"
+#include "OutOfCoreMatrix.h"
+#include "SolverTuner.h"
 
 typedef std::vector< std::vector<double> > VECMATRIX;
 
@@ -35,18 +37,39 @@ protected:
     std::vector<double> x;  // the numerical solution
 
     std::vector< std::list<maColEle> > ma; // list-stored stiffness matrix
+    LinearSolver *solver; // kept between solves while the pattern of ma stays
+    OutOfCoreMatrix *staging; // takes the entries instead of ma in out-of-core assembly, until the solve
+    bool keepFactorization;   // new solvers keep their numeric factorization for solver -> solve
 
-    BasicSolvingSystem(Mesh* m, Problem* p):mesh(m), prob(p) {}
+    BasicSolvingSystem(Mesh* m, Problem* p):mesh(m), prob(p), dof(0), rh(nullptr), solver(nullptr), staging(nullptr),
+        keepFactorization(false) {}
 
-    int addToMA(double a, int row, int col); // add value to list-stored stiffness matrix ma
+    int addToMA(double a, int row, int col); // add value to list-stored stiffness matrix ma, or to staging
+    void beginStaging(); // start staging a new matrix if the input asks for out-of-core assembly
+    
+    LinearSolver *newSolver(SolverChoice choice, const std::string &stagedFile);
+    bool autotuneSolver(const std::string &stagedFile); // pick the solver by timing, see SolverTuner
     
 public:
     virtual void solveSparse(); // solve the sparse linear system
     virtual void output();
+    virtual void report(); // file output run report, *.report.json
     virtual void assembleStiff() = 0;
+    virtual void reassembleValues() = 0; // assemble again after epsilon or sigma0 changed, keeping the pattern of ma
+    virtual bool refineAdaptive(int refineLevel) { return false; } // refine the mesh where the error is large
+    virtual void solveTransient() // time stepping from the assembled system, see DGSolvingSystem
+    {
+        throw std::runtime_error("time stepping is not supported by this solving system");
+    }
+    virtual void solveNonlinear() // Newton's method for a problem with a reaction term, from the assembled system
+    {
+        throw std::runtime_error("problems with a reaction term are not supported by this solving system");
+    }
     
     virtual ~BasicSolvingSystem() {
         delete[] rh;
+        delete solver;
+        delete staging;
     };
 };
 
@@ -18,5 +18,62 @@ DGProblem::DGProblem(int argc, char const *argv[]):Problem(argc, argv)
     cout << " epsilon = " << epsilon << endl
     << " sigma0 = " << sigma0 << endl
     << " beta0 = " << beta0 << endl
-    << " refinement level = " << parameters.nRefine << endl;
+    << " refinement level = " << parameters.nRefine << endl
+    << " problem = " << parameters.problemName << endl;
+}
+
+ExpressionProblem::ExpressionProblem(const Problem &p): DGProblem(p), fExpr(p.parameters.fExpression),
+    gdExpr(p.parameters.gdExpression), trueSolExpr(p.parameters.trueSolExpression)
+{
+    cout << " f = " << fExpr.text() << endl
+    << " gd = " << gdExpr.text() << endl
+    << " trueSol = " << trueSolExpr.text() << endl;
+}
+
+namespace {
+    template <class Coeff>
+    Problem *createStatic(const Problem &input)
+    {
+        return new StaticProblem<Coeff>(input);
+    }
+    
+    template <class Coeff>
+    Problem *createSemilinear(const Problem &input)
+    {
+        return new SemilinearProblem<Coeff>(input);
+    }
+    
+    Problem *createVirtual(const Problem &input)
+    {
+        return new DGProblem(input);
+    }
+    
+    Problem *createExpression(const Problem &input)
+    {
+        return new ExpressionProblem(input);
+    }
+    
+    struct ProblemEntry {
+        const char *name;
+        Problem *(*create)(const Problem &input);
+    };
+    
+    const ProblemEntry builtinProblems[] = {
+        {"quadratic", createStatic<QuadraticCoeff>},
+        {"cossin", createStatic<CosSinCoeff>},
+        {"cubic", createSemilinear<CubicCoeff>},
+        {"virtual", createVirtual},
+        {"expression", createExpression}
+    };
+}
+
+std::unique_ptr<Problem> createProblem(const Problem &input)
+{
+    string names;
+    for (const ProblemEntry &entry : builtinProblems) {
+        if (input.parameters.problemName == entry.name)
+            return std::unique_ptr<Problem>(entry.create(input));
+        names += string(" ") + entry.name;
+    }
+    throw std::runtime_error("unknown problem " + input.parameters.problemName + ", built-in problems are" + names);
 }
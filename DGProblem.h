@@ -10,38 +10,173 @@
 #define __tri__DGProblem__
 
 #include <iostream>
+#include <memory>
 #include "problem.h"
+#include "Expression.h"
 
-// the problem to be solved here is
-// -\Delta u + u = 3\cos x \sin y, (x,y) \in \Omega = [\frac{\pi}{2}, \frac{3\pi}{2}] \times [0, \pi]
-// u = 0, (x,y) \in \Gamma
+// -\Delta u = -1, u = (x^2 + y^2) / 4 + 2
+struct QuadraticCoeff {
+    static double f(double x, double y)
+    {
+        return -1;
+    }
+    static double gd(double x, double y)
+    {
+        return 0.25 * (x * x + y * y) + 2;
+    }
+    static double trueSol(double x, double y)
+    {
+        return 0.25 * (x * x + y * y) + 2;
+    }
+};
+
+// -\Delta u = 2\cos x \sin y, u = \cos x \sin y, which vanishes on the boundary of \Omega
+struct CosSinCoeff {
+    static double f(double x, double y)
+    {
+        return 2 * cos(x) * sin(y);
+    }
+    static double gd(double x, double y)
+    {
+        return cos(x) * sin(y);
+    }
+    static double trueSol(double x, double y)
+    {
+        return cos(x) * sin(y);
+    }
+};
+
+// -\Delta u + u^3 = 2\cos x \sin y + (\cos x \sin y)^3, u = \cos x \sin y
+struct CubicCoeff {
+    static double f(double x, double y)
+    {
+        double u = cos(x) * sin(y);
+        return 2 * u + u * u * u;
+    }
+    static double gd(double x, double y)
+    {
+        return cos(x) * sin(y);
+    }
+    static double trueSol(double x, double y)
+    {
+        return cos(x) * sin(y);
+    }
+    static void reaction(double u, double &r, double &dr)
+    {
+        r = u * u * u;
+        dr = 3 * u * u;
+    }
+};
+
+// the problem of QuadraticCoeff through the virtual f, gd and trueSol, which the batch loops of
+// Problem call point by point; the problems below override the batches as well
 class DGProblem: public Problem {
 public:
+    DGProblem() {}
     // read parameters from an input file
     DGProblem(int argc, char const *argv[]);
+    DGProblem(const Problem &p): Problem(p) {}
+    
+    double f(double x, double y)
+    {
+        return QuadraticCoeff::f(x, y);
+    }
+    double gd(double x, double y)
+    {
+        return QuadraticCoeff::gd(x, y);
+    }
+    double trueSol(double x, double y)
+    {
+        return QuadraticCoeff::trueSol(x, y);
+    }
+};
+
+// a built-in problem, Coeff gives f, gd and trueSol as static functions so
+// every loop over them is instantiated with the coefficients inlined
+template <class Coeff>
+class StaticProblem: public DGProblem {
+public:
+    StaticProblem(const Problem &p): DGProblem(p) {}
     
-    // double f(double x, double y)
-    // {
-    //     return 2 * cos(x) * sin(y);
-    //     // return 1.0;
-    // }
-    // double trueSol(double x, double y)
-    // {
-    //     return cos(x) * sin(y);
-    // }
+    double f(double x, double y)
+    {
+        return Coeff::f(x, y);
+    }
+    double gd(double x, double y)
+    {
+        return Coeff::gd(x, y);
+    }
+    double trueSol(double x, double y)
+    {
+        return Coeff::trueSol(x, y);
+    }
+    
+    void fBatch(const double *x, const double *y, double *value, int n)
+    {
+        for (int i = 0; i < n; i++)
+            value[i] = Coeff::f(x[i], y[i]);
+    }
+    void gdBatch(const double *x, const double *y, double *value, int n)
+    {
+        for (int i = 0; i < n; i++)
+            value[i] = Coeff::gd(x[i], y[i]);
+    }
+    void trueSolBatch(const double *x, const double *y, double *value, int n)
+    {
+        for (int i = 0; i < n; i++)
+            value[i] = Coeff::trueSol(x[i], y[i]);
+    }
+};
+
+// a built-in problem with a reaction term, Coeff also gives reaction(u, r, dr)
+template <class Coeff>
+class SemilinearProblem: public StaticProblem<Coeff> {
+public:
+    SemilinearProblem(const Problem &p): StaticProblem<Coeff>(p) {}
+    
+    bool hasReaction() { return true; }
+    void reactionBatch(const double *u, double *r, double *dr, int n)
+    {
+        for (int i = 0; i < n; i++)
+            Coeff::reaction(u[i], r[i], dr[i]);
+    }
+};
+
+// f, gd and trueSol given as expressions in the input file
+class ExpressionProblem: public DGProblem {
+    Expression fExpr, gdExpr, trueSolExpr;
+public:
+    ExpressionProblem(const Problem &p);
     
     double f(double x, double y)
     {
-        return -1;
+        return fExpr.evaluate(x, y);
     }
     double gd(double x, double y)
     {
-        return 0.25 * (x * x + y * y) + 2;
+        return gdExpr.evaluate(x, y);
     }
     double trueSol(double x, double y)
     {
-        return 0.25 * (x * x + y * y) + 2;
+        return trueSolExpr.evaluate(x, y);
+    }
+    
+    void fBatch(const double *x, const double *y, double *value, int n)
+    {
+        fExpr.evaluate(x, y, value, n);
+    }
+    void gdBatch(const double *x, const double *y, double *value, int n)
+    {
+        gdExpr.evaluate(x, y, value, n);
+    }
+    void trueSolBatch(const double *x, const double *y, double *value, int n)
+    {
+        trueSolExpr.evaluate(x, y, value, n);
     }
 };
 
+// the problem named by parameters.problemName in input, "virtual" keeps
+// DGProblem and its virtual calls
+std::unique_ptr<Problem> createProblem(const Problem &input);
+
 #endif /* defined(__tri__DGProblem__) */
@@ -7,12 +7,15 @@
 //
 
 #include "DGSolvingSystem.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <memory>
 
 using std::vector;
 using std::cout;
 using std::endl;
     
-DGSolvingSystem::DGSolvingSystem(Mesh* m, Problem* p):BasicSolvingSystem(m, p)
+DGSolvingSystem::DGSolvingSystem(Mesh* m, Problem* p):BasicSolvingSystem(m, p), assembleScale(1)
 {
     //calc penalty
     penaltyOver6 = prob->sigma0 / 6.0;
@@ -27,14 +30,7 @@ VECMATRIX DGSolvingSystem::elementInteg(Element ele)
     //     cout << "  local dof = " << ele.localDof << endl;
     // #endif
     
-    double x1(mesh -> vertex[ele.vertex[0] - 1].x), y1(mesh -> vertex[ele.vertex[0] - 1].y),
-    x2(mesh -> vertex[ele.vertex[1] - 1].x), y2(mesh -> vertex[ele.vertex[1] - 1].y),
-    x3(mesh -> vertex[ele.vertex[2] - 1].x), y3(mesh -> vertex[ele.vertex[2] - 1].y);
-    
-    VECMATRIX vecGrad(3);
-    vecGrad[0].push_back(y2 - y3); vecGrad[0].push_back(x3 - x2);
-    vecGrad[1].push_back(y3 - y1); vecGrad[1].push_back(x1 - x3);
-    vecGrad[2].push_back(y1 - y2); vecGrad[2].push_back(x2 - x1);
+    const double (*vecGrad)[2] = elementGeometry[ele.index - 1].grad;
     
     for (int i = 0; i < 3; i++)
         for (int j = i; j < 3; j++) {
@@ -51,18 +47,22 @@ VECMATRIX DGSolvingSystem::elementInteg(Element ele)
     return vecElementInteg;
 }
 
+VECMATRIX DGSolvingSystem::elementMass(Element ele)
+{
+    VECMATRIX mass(LocalDimension, vector<double>(LocalDimension, ele.detBE / 24.0));
+    for (int i = 0; i < LocalDimension; i++)
+        mass[i][i] = ele.detBE / 12.0;
+    return mass;
+}
+
 vector<double> DGSolvingSystem::elementIntegRhs(Element ele)
 {
     vector<double> vecElementIntegRhs;
     
-    double x1(mesh -> vertex[ele.vertex[0] - 1].x), y1(mesh -> vertex[ele.vertex[0] - 1].y),
-    x2(mesh -> vertex[ele.vertex[1] - 1].x), y2(mesh -> vertex[ele.vertex[1] - 1].y),
-    x3(mesh -> vertex[ele.vertex[2] - 1].x), y3(mesh -> vertex[ele.vertex[2] - 1].y);
-    
     vecElementIntegRhs.resize(LocalDimension);
-    vecElementIntegRhs[0] = prob -> f(x1, y1) * ele.detBE / 6.0;
-    vecElementIntegRhs[1] = prob -> f(x2, y2) * ele.detBE / 6.0;
-    vecElementIntegRhs[2] = prob -> f(x3, y3) * ele.detBE / 6.0;
+    vecElementIntegRhs[0] = fVertex[ele.vertex[0] - 1] * ele.detBE / 6.0;
+    vecElementIntegRhs[1] = fVertex[ele.vertex[1] - 1] * ele.detBE / 6.0;
+    vecElementIntegRhs[2] = fVertex[ele.vertex[2] - 1] * ele.detBE / 6.0;
     
     return vecElementIntegRhs;
 }
@@ -74,14 +74,14 @@ int DGSolvingSystem::assembleElement(Element ele)
     
     for (int row = 0; row != vecElementInteg.size(); ++row)
         for (int col = 0; col != vecElementInteg[row].size(); ++col) {
-            this -> addToMA(vecElementInteg[row][col], ele.dofIndex + row, ele.dofIndex + col);
+            this -> addToMA(assembleScale * vecElementInteg[row][col], ele.dofIndex + row, ele.dofIndex + col);
         }
     
     // why commenting off this part causes a segmentation fault?
     vector<double> vecElementIntegRhs;
     vecElementIntegRhs = elementIntegRhs(ele);
     for (int i = 0; i != vecElementIntegRhs.size(); ++i) {
-        this -> rh[ele.dofIndex + i] += vecElementIntegRhs[i];
+        this -> rh[ele.dofIndex + i] += assembleScale * vecElementIntegRhs[i];
     }
     
     return 0;
@@ -92,112 +92,96 @@ double DGSolvingSystem::dist(double x1, double y1, double x2, double y2)
     return sqrt((x1 - x2) * (x1 - x2) + (y1 - y2) * (y1 - y2));
 }
 
-int DGSolvingSystem::vertexOnEdge(Vertex ver, Vertex v1, Vertex v2)
+bool DGSolvingSystem::isSide(const Edge &edge, const Element &E)
 {
-    double A = v2.y - v1.y;
-    double B = v1.x - v2.x;
-    double C = v1.y * (v2.x - v1.x) - v1.x * (v2.y - v1.y);
-    double dis = fabs( (double)(A * ver.x + B * ver.y + C) / sqrt(A * A + B * B));
-    if (dis < 0.0001)
-        return 1;
-    return 0;
+    int shared(0);
+    for (int ver : E.vertex)
+        shared += (ver == edge.vertex[0]) + (ver == edge.vertex[1]);
+    return shared == 2;
 }
 
-int DGSolvingSystem::calc_ne_and_f_on_edge(Edge edge, vector<double> &ne,
-                                           VECMATRIX &f_E1, VECMATRIX &f_E2)
+// edge is a side of E: f_E[i][k] is 1 if vertex i of E is vertex k of edge and 0 otherwise, without branches
+int DGSolvingSystem::sideTrace(const Edge &edge, const Element &E, double f_E[3][2])
 {
-    
-    if (edge.neighborElement.size() != 2) {
-        cout << "invalid call in computing normal vector, element size not equal to 2" << endl;
-        return 1;
+    int opposite(0);
+    for (int i = 0; i < 3; i++) {
+        f_E[i][0] = E.vertex[i] == edge.vertex[0];
+        f_E[i][1] = E.vertex[i] == edge.vertex[1];
+        opposite += i * (E.vertex[i] != edge.vertex[0] && E.vertex[i] != edge.vertex[1]);
     }
-    
-    Element &E1 = mesh -> element[ edge.neighborElement[0] - 1];
-    Element &E2 = mesh -> element[ edge.neighborElement[1] - 1];
-    
-    double x1, x2, x3, y1, y2, y3, a2, a3, b2, b3;
-    
-    int index_E1_v1 = -1;
-    for (int ver : E1.vertex) {
-        ++index_E1_v1;
-        if (edge.vertex[0] == ver || edge.vertex[1] == ver)
-            continue;
-        if ( vertexOnEdge(mesh -> vertex[ver - 1], mesh -> vertex[edge.vertex[0] - 1], mesh -> vertex[edge.vertex[1] - 1]) )
-            continue;
-        x1 = mesh -> vertex[ver - 1].x;
-        y1 = mesh -> vertex[ver - 1].y;
-        break;
+    return opposite;
+}
+
+// edge lies on a side of E: the parents of edge are followed up to that side, composing
+// where the vertices of edge lie on it, and f_E[i][k] is the basis function of vertex i at
+// vertex k of edge
+int DGSolvingSystem::hangingTrace(const Edge &edge, const Element &E, double f_E[3][2])
+{
+    double t[2] = {0, 1}; // the vertices of edge on the edge side
+    const Edge *side = &edge;
+    while (true) {
+        int a(-1), b(-1);
+        for (int i = 0; i < 3; i++) {
+            if (E.vertex[i] == side -> vertex[0])
+                a = i;
+            if (E.vertex[i] == side -> vertex[1])
+                b = i;
+        }
+        if (a >= 0 && b >= 0) {
+            int opposite = 3 - a - b;
+            for (int k = 0; k < 2; k++) {
+                f_E[opposite][k] = 0;
+                f_E[a][k] = 1 - t[k];
+                f_E[b][k] = t[k];
+            }
+            return opposite;
+        }
+        if (side -> parent == 0)
+            throw std::runtime_error("edge " + std::to_string(edge.index) + " is not on a side of element " + std::to_string(E.index));
+        for (int k = 0; k < 2; k++)
+            t[k] = side -> t0 + t[k] * (side -> t1 - side -> t0);
+        side = &mesh -> edge[side -> parent - 1];
     }
-    
-    x2 = mesh -> vertex[E1.vertex[(index_E1_v1 + 1) % 3] - 1].x;
-    y2 = mesh -> vertex[E1.vertex[(index_E1_v1 + 1) % 3] - 1].y;
-    x3 = mesh -> vertex[E1.vertex[(index_E1_v1 + 2) % 3] - 1].x;
-    y3 = mesh -> vertex[E1.vertex[(index_E1_v1 + 2) % 3] - 1].y;
-    
-    a2 = mesh -> vertex[edge.vertex[0] - 1].x;
-    b2 = mesh -> vertex[edge.vertex[0] - 1].y;
-    a3 = mesh -> vertex[edge.vertex[1] - 1].x;
-    b3 = mesh -> vertex[edge.vertex[1] - 1].y;
+}
+
+// ne = |e| / 4 * n_e, n_e the unit normal pointing out of E1, whose vertex opposite to edge is vertex opposite
+void DGSolvingSystem::interiorNormal(const Edge &edge, const Element &E1, int opposite, double ne[2])
+{
+    double x1 = mesh -> vertex[E1.vertex[opposite] - 1].x;
+    double y1 = mesh -> vertex[E1.vertex[opposite] - 1].y;
+    double a2 = mesh -> vertex[edge.vertex[0] - 1].x;
+    double b2 = mesh -> vertex[edge.vertex[0] - 1].y;
+    double a3 = mesh -> vertex[edge.vertex[1] - 1].x;
+    double b3 = mesh -> vertex[edge.vertex[1] - 1].y;
     
     if ( ((a2 - x1) * (b3 - y1) - (a3 - x1) * (b2 - y1)) < 0 ) {
         std::swap(a2, a3);
         std::swap(b2, b3);
     }
     
-    ne.clear();
-    ne.push_back( (b3 - b2) / 4.0 );
-    ne.push_back( (a2 - a3) / 4.0 );
-    
-    f_E1.resize(3);
-    f_E1[index_E1_v1] = vector<double> {0, 0};
-    
-    double length_v2v3 = dist(x2, y2, x3, y3);
-    f_E1[(index_E1_v1 + 1) % 3].push_back( dist(a2, b2, x3, y3) / length_v2v3 );
-    f_E1[(index_E1_v1 + 1) % 3].push_back( dist(a3, b3, x3, y3) / length_v2v3 );
-    f_E1[(index_E1_v1 + 2) % 3].push_back( dist(a2, b2, x2, y2) / length_v2v3 );
-    f_E1[(index_E1_v1 + 2) % 3].push_back( dist(a3, b3, x2, y2) / length_v2v3 );
-    
-    int index_E2_v1 = -1;
-    for (int ver : E2.vertex) {
-        ++index_E2_v1;
-        if (edge.vertex[0] == ver || edge.vertex[1] == ver)
-            continue;
-        if ( vertexOnEdge(mesh -> vertex[ver - 1], mesh -> vertex[edge.vertex[0] - 1], mesh -> vertex[edge.vertex[1] - 1]) )
-            continue;
-        x1 = mesh -> vertex[ver - 1].x;
-        y1 = mesh -> vertex[ver - 1].y;
-        break;
-    }
-    
-    x2 = mesh -> vertex[E2.vertex[(index_E2_v1 + 1) % 3] - 1].x;
-    y2 = mesh -> vertex[E2.vertex[(index_E2_v1 + 1) % 3] - 1].y;
-    x3 = mesh -> vertex[E2.vertex[(index_E2_v1 + 2) % 3] - 1].x;
-    y3 = mesh -> vertex[E2.vertex[(index_E2_v1 + 2) % 3] - 1].y;
-    
-    a2 = mesh -> vertex[edge.vertex[0] - 1].x;
-    b2 = mesh -> vertex[edge.vertex[0] - 1].y;
-    a3 = mesh -> vertex[edge.vertex[1] - 1].x;
-    b3 = mesh -> vertex[edge.vertex[1] - 1].y;
-    
-    if ( ((a2 - x1) * (b3 - y1) - (a3 - x1) * (b2 - y1)) < 0 ) {
-        std::swap(a2, a3);
-        std::swap(b2, b3);
+    ne[0] = (b3 - b2) / 4.0;
+    ne[1] = (a2 - a3) / 4.0;
+}
+
+int DGSolvingSystem::calc_ne_and_f_on_edge(const Edge &edge, double ne[2],
+                                           double f_E1[3][2], double f_E2[3][2])
+{
+    if (edge.neighborElement.size() != 2) {
+        cout << "invalid call in computing normal vector, element size not equal to 2" << endl;
+        return 1;
     }
     
-    f_E2.resize(3);
-    f_E2[index_E2_v1] = vector<double> {0, 0};
+    Element &E1 = mesh -> element[ edge.neighborElement[0] - 1];
+    Element &E2 = mesh -> element[ edge.neighborElement[1] - 1];
     
-    length_v2v3 = dist(x2, y2, x3, y3);
-    f_E2[(index_E2_v1 + 1) % 3].push_back( dist(a2, b2, x3, y3) / length_v2v3 );
-    f_E2[(index_E2_v1 + 1) % 3].push_back( dist(a3, b3, x3, y3) / length_v2v3 );
-    f_E2[(index_E2_v1 + 2) % 3].push_back( dist(a2, b2, x2, y2) / length_v2v3 );
-    f_E2[(index_E2_v1 + 2) % 3].push_back( dist(a3, b3, x2, y2) / length_v2v3 );
+    interiorNormal(edge, E1, hangingTrace(edge, E1, f_E1), ne);
+    hangingTrace(edge, E2, f_E2);
     
     return 0;
 }
 
-int DGSolvingSystem::calc_ne_and_f_on_edge(Edge edge, vector<double> &ne,
-                                           VECMATRIX &f_E1)
+int DGSolvingSystem::calc_ne_and_f_on_edge(const Edge &edge, double ne[2],
+                                           double f_E1[3][2])
 {
     if (edge.neighborElement.size() != 1) {
         cout << "invalid call in computing nomal vector, element size not equal to 1" << endl;
@@ -205,43 +189,92 @@ int DGSolvingSystem::calc_ne_and_f_on_edge(Edge edge, vector<double> &ne,
     }
     
     Element &E1 = mesh -> element[ edge.neighborElement[0] - 1];
-    double x1, x2, x3, y1, y2, y3;
-    
-    int index_E1_v1 = -1;
-    for (int ver : E1.vertex) {
-        ++index_E1_v1;
-        if (edge.vertex[0] == ver) {
-            continue;
-        }
-        if (edge.vertex[1] == ver) {
-            continue;
-        }
-        x1 = mesh -> vertex[ver - 1].x;
-        y1 = mesh -> vertex[ver - 1].y;
-        break;
-    }
+    int index_E1_v1 = sideTrace(edge, E1, f_E1);
     
+    double x2, x3, y2, y3;
     x2 = mesh -> vertex[E1.vertex[(index_E1_v1 + 1) % 3] - 1].x;
     y2 = mesh -> vertex[E1.vertex[(index_E1_v1 + 1) % 3] - 1].y;
     x3 = mesh -> vertex[E1.vertex[(index_E1_v1 + 2) % 3] - 1].x;
     y3 = mesh -> vertex[E1.vertex[(index_E1_v1 + 2) % 3] - 1].y;
     
-    ne.clear();
-    ne.push_back( (y3 - y2) / 2.0 );
-    ne.push_back( (x2 - x3) / 2.0 );
-    
-    f_E1.resize(3);
-    f_E1[index_E1_v1] = vector<double> {0, 0};
-    
-    f_E1[(index_E1_v1 + 1) % 3].push_back( 1.0 );
-    f_E1[(index_E1_v1 + 1) % 3].push_back( 0.0 );
-    f_E1[(index_E1_v1 + 2) % 3].push_back( 0.0 );
-    f_E1[(index_E1_v1 + 2) % 3].push_back( 1.0 );
+    ne[0] = (y3 - y2) / 2.0;
+    ne[1] = (x2 - x3) / 2.0;
     
     return 0;
 }
 
-double DGSolvingSystem::innerProduct(vector<double> x, vector<double> y)
+void DGSolvingSystem::computeGeometry(const vector<int> &elements, const vector<int> &edges)
+{
+    PhaseTimer timer(Phase::Geometry);
+    elementGeometry.resize(mesh -> element.size());
+    edgeGeometry.resize(mesh -> edge.size());
+    
+    parallelFor((int) elements.size(), [&](int k) {
+        Element &ele = mesh -> element[elements[k] - 1];
+        double x1(mesh -> vertex[ele.vertex[0] - 1].x), y1(mesh -> vertex[ele.vertex[0] - 1].y),
+        x2(mesh -> vertex[ele.vertex[1] - 1].x), y2(mesh -> vertex[ele.vertex[1] - 1].y),
+        x3(mesh -> vertex[ele.vertex[2] - 1].x), y3(mesh -> vertex[ele.vertex[2] - 1].y);
+        
+        ElementGeometry &geo = elementGeometry[ele.index - 1];
+        geo.grad[0][0] = y2 - y3; geo.grad[0][1] = x3 - x2;
+        geo.grad[1][0] = y3 - y1; geo.grad[1][1] = x1 - x3;
+        geo.grad[2][0] = y1 - y2; geo.grad[2][1] = x2 - x1;
+        geo.det = (x2 - x1) * (y3 - y1) - (x3 - x1) * (y2 - y1);
+    });
+    
+    // interior edges that are sides of both neighbors are conforming, the others hang
+    // on a side of a coarser neighbor and take their traces from their parents
+    vector<int> conforming, hanging, boundary;
+    for (int iEdge : edges) {
+        Edge &ed = mesh -> edge[iEdge - 1];
+        if (ed.neighborElement.size() != 2)
+            boundary.push_back(iEdge);
+        else if (isSide(ed, mesh -> element[ed.neighborElement[0] - 1]) && isSide(ed, mesh -> element[ed.neighborElement[1] - 1]))
+            conforming.push_back(iEdge);
+        else
+            hanging.push_back(iEdge);
+    }
+    
+    // the edges only read the mesh, each writes its own entry
+    parallelFor((int) conforming.size(), [&](int k) {
+        Edge &ed = mesh -> edge[conforming[k] - 1];
+        EdgeGeometry &geo = edgeGeometry[ed.index - 1];
+        Element &E1 = mesh -> element[ed.neighborElement[0] - 1];
+        interiorNormal(ed, E1, sideTrace(ed, E1, geo.f_E1), geo.ne);
+        sideTrace(ed, mesh -> element[ed.neighborElement[1] - 1], geo.f_E2);
+    });
+    parallelFor((int) hanging.size(), [&](int k) {
+        Edge &ed = mesh -> edge[hanging[k] - 1];
+        EdgeGeometry &geo = edgeGeometry[ed.index - 1];
+        calc_ne_and_f_on_edge(ed, geo.ne, geo.f_E1, geo.f_E2);
+    });
+    parallelFor((int) boundary.size(), [&](int k) {
+        Edge &ed = mesh -> edge[boundary[k] - 1];
+        EdgeGeometry &geo = edgeGeometry[ed.index - 1];
+        calc_ne_and_f_on_edge(ed, geo.ne, geo.f_E1);
+    });
+}
+
+void DGSolvingSystem::computeGeometry()
+{
+    vector<int> elements, edges;
+    for (Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            elements.push_back(ele.index);
+    for (Edge &ed : mesh -> edge)
+        if (ed.reftype == constNonrefined)
+            edges.push_back(ed.index);
+    computeGeometry(elements, edges);
+}
+
+void DGSolvingSystem::grad_ne(const Element &E, const double ne[2], double grad_ne_E[3])
+{
+    const ElementGeometry &geo = elementGeometry[E.index - 1];
+    for (int i = 0; i < 3; i++)
+        grad_ne_E[i] = (geo.grad[i][0] * ne[0] + geo.grad[i][1] * ne[1]) / E.detBE;
+}
+
+double DGSolvingSystem::innerProduct(const double x[2], const double y[2])
 {
     return x[0] * y[0] + x[1] * y[1];
 }
@@ -272,19 +305,15 @@ void DGSolvingSystem::initM(VECMATRIX &M11, int dofE1)
         M11[i].resize(dofE1);
 }
 
-double DGSolvingSystem::penaltyTerm(Edge edge, int index_E1, int index_E2, int iver, int jver, VECMATRIX f_E1, VECMATRIX f_E2)
+// the trace tables of both elements are in the order of the vertices of the edge
+double DGSolvingSystem::penaltyTerm(int iver, int jver, const double f_E1[3][2], const double f_E2[3][2])
 {
-    if (index_E1 == index_E2)
-        return 2 * f_E2[jver][0] * f_E1[iver][0] + 2 * f_E2[jver][1] * f_E1[iver][1]
-        + f_E2[jver][0] * f_E1[iver][1] + f_E2[jver][1] * f_E1[iver][0];
-    else
-        return 2 * f_E2[jver][0] * f_E1[iver][1] + 2 * f_E2[jver][1] * f_E1[iver][0]
-        + f_E2[jver][0] * f_E1[iver][0] + f_E2[jver][1] * f_E1[iver][1];
-    
+    return 2 * f_E2[jver][0] * f_E1[iver][0] + 2 * f_E2[jver][1] * f_E1[iver][1]
+    + f_E2[jver][0] * f_E1[iver][1] + f_E2[jver][1] * f_E1[iver][0];
 }
 
-int DGSolvingSystem::getMii(Edge edge, VECMATRIX &M, Element E1, Element E2, VECMATRIX f_E1, VECMATRIX f_E2, double eps,
-                            vector<double> ne, vector<double> grad_ne_E1, vector<double> grad_ne_E2, int sign1, int sign2, int sign3)
+int DGSolvingSystem::getMii(VECMATRIX &M, const Element &E1, const Element &E2, const double f_E1[3][2], const double f_E2[3][2],
+                            double eps, const double grad_ne_E1[3], const double grad_ne_E2[3], int sign1, int sign2, int sign3)
 {
     int row(0), col(0);
     for (int iver = 0; iver != E1.vertex.size(); ++iver) {
@@ -296,7 +325,7 @@ int DGSolvingSystem::getMii(Edge edge, VECMATRIX &M, Element E1, Element E2, VEC
             //  continue;
             M[row][col] =  sign1 * (f_E1[iver][0] + f_E1[iver][1]) * grad_ne_E2[jver]
             + sign2 * eps * (f_E2[jver][0] + f_E2[jver][1]) * grad_ne_E1[iver];
-            M[row][col] += sign3 * penaltyOver6 * penaltyTerm(edge, E1.index, E2.index, iver, jver, f_E1, f_E2);
+            M[row][col] += sign3 * penaltyOver6 * penaltyTerm(iver, jver, f_E1, f_E2);
             ++col;
         }
         ++row;
@@ -315,47 +344,20 @@ int DGSolvingSystem::edgeInteg(Edge edge, VECMATRIX &M11, VECMATRIX &M12, VECMAT
     Element &E1 = mesh -> element[edge.neighborElement[0] - 1];
     Element &E2 = mesh -> element[edge.neighborElement[1] - 1];
     
-    double E1_x1(mesh -> vertex[ E1.vertex[0] - 1].x),
-    E1_x2(mesh -> vertex[ E1.vertex[1] - 1].x),
-    E1_x3(mesh -> vertex[ E1.vertex[2] - 1].x),
-    E1_y1(mesh -> vertex[ E1.vertex[0] - 1].y),
-    E1_y2(mesh -> vertex[ E1.vertex[1] - 1].y),
-    E1_y3(mesh -> vertex[ E1.vertex[2] - 1].y);
-    double E2_x1(mesh -> vertex[ E2.vertex[0] - 1].x),
-    E2_x2(mesh -> vertex[ E2.vertex[1] - 1].x),
-    E2_x3(mesh -> vertex[ E2.vertex[2] - 1].x),
-    E2_y1(mesh -> vertex[ E2.vertex[0] - 1].y),
-    E2_y2(mesh -> vertex[ E2.vertex[1] - 1].y),
-    E2_y3(mesh -> vertex[ E2.vertex[2] - 1].y);
-    
-    vector<double> ne; // actually n_e^* as in the report
-    VECMATRIX f_E1, f_E2;
-    calc_ne_and_f_on_edge(edge, ne, f_E1, f_E2); // normal vector, not unit, actualy |e| / 4 * n_e
-    
-    vector<double> grad_ne_E1; // \nabla \phi_i^{E_1} \cdot n_e^*
-    grad_ne_E1.push_back( ((E1_y2 - E1_y3) * ne[0] + (E1_x3 - E1_x2) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y3 - E1_y1) * ne[0] + (E1_x1 - E1_x3) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y1 - E1_y2) * ne[0] + (E1_x2 - E1_x1) * ne[1]) / E1.detBE );
-    
-    vector<double> grad_ne_E2; // \nabla \phi_i^{E_2} \cdot n_e^*
-    grad_ne_E2.push_back( ((E2_y2 - E2_y3) * ne[0] + (E2_x3 - E2_x2) * ne[1]) / E2.detBE );
-    grad_ne_E2.push_back( ((E2_y3 - E2_y1) * ne[0] + (E2_x1 - E2_x3) * ne[1]) / E2.detBE );
-    grad_ne_E2.push_back( ((E2_y1 - E2_y2) * ne[0] + (E2_x2 - E2_x1) * ne[1]) / E2.detBE );
+    const EdgeGeometry &geo = edgeGeometry[edge.index - 1]; // ne is n_e^* as in the report, not unit, actualy |e| / 4 * n_e
     
-//     #ifdef __DGSOLVESYS_DEBUG_EDGE
-//          cout << "  normal vector from element " << edge.neighborElement[0]
-//               << " to element " << edge.neighborElement[1] << " = ("
-//               << ne[0] << ", " << ne[1] << ")" << endl;
-//     #endif
+    double grad_ne_E1[3], grad_ne_E2[3]; // \nabla \phi_i^{E_1} \cdot n_e^*
+    grad_ne(E1, geo.ne, grad_ne_E1);
+    grad_ne(E2, geo.ne, grad_ne_E2);
     
     initM(M11, M12, M21, M22, E1.localDof, E2.localDof);
     
     const double eps = prob->epsilon;
     
-    getMii(edge, M11, E1, E1, f_E1, f_E1, eps, ne, grad_ne_E1, grad_ne_E1, -1,  1,  1);
-    getMii(edge, M12, E1, E2, f_E1, f_E2, eps, ne, grad_ne_E1, grad_ne_E2, -1, -1, -1);
-    getMii(edge, M21, E2, E1, f_E2, f_E1, eps, ne, grad_ne_E2, grad_ne_E1,  1,  1, -1);
-    getMii(edge, M22, E2, E2, f_E2, f_E2, eps, ne, grad_ne_E2, grad_ne_E2,  1, -1,  1);
+    getMii(M11, E1, E1, geo.f_E1, geo.f_E1, eps, grad_ne_E1, grad_ne_E1, -1,  1,  1);
+    getMii(M12, E1, E2, geo.f_E1, geo.f_E2, eps, grad_ne_E1, grad_ne_E2, -1, -1, -1);
+    getMii(M21, E2, E1, geo.f_E2, geo.f_E1, eps, grad_ne_E2, grad_ne_E1,  1,  1, -1);
+    getMii(M22, E2, E2, geo.f_E2, geo.f_E2, eps, grad_ne_E2, grad_ne_E2,  1, -1,  1);
     return 0;
 }
 
@@ -368,21 +370,10 @@ int DGSolvingSystem::edgeInteg(Edge edge, VECMATRIX &M11, vector<double> &rhs)
     
     Element &E1 = mesh -> element[edge.neighborElement[0] - 1];
     
-    double E1_x1(mesh -> vertex[ E1.vertex[0] - 1].x),
-    E1_x2(mesh -> vertex[ E1.vertex[1] - 1].x),
-    E1_x3(mesh -> vertex[ E1.vertex[2] - 1].x),
-    E1_y1(mesh -> vertex[ E1.vertex[0] - 1].y),
-    E1_y2(mesh -> vertex[ E1.vertex[1] - 1].y),
-    E1_y3(mesh -> vertex[ E1.vertex[2] - 1].y);
-    
-    vector<double> ne;
-    VECMATRIX f_E1;
-    calc_ne_and_f_on_edge(edge, ne, f_E1); // normal vector, not unit, actualy |e| / 2 * n_e
+    const EdgeGeometry &geo = edgeGeometry[edge.index - 1]; // ne not unit, actualy |e| / 2 * n_e
     
-    vector<double> grad_ne_E1;
-    grad_ne_E1.push_back( ((E1_y2 - E1_y3) * ne[0] + (E1_x3 - E1_x2) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y3 - E1_y1) * ne[0] + (E1_x1 - E1_x3) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y1 - E1_y2) * ne[0] + (E1_x2 - E1_x1) * ne[1]) / E1.detBE );
+    double grad_ne_E1[3];
+    grad_ne(E1, geo.ne, grad_ne_E1);
     
 //     #ifdef __DGSOLVESYS_DEBUG_EDGE
 //      cout << "  normal vector on boundary edge " << edge.index
@@ -393,32 +384,37 @@ int DGSolvingSystem::edgeInteg(Edge edge, VECMATRIX &M11, vector<double> &rhs)
     const double eps = prob->epsilon;
     
     // M11
-    getMii(edge, M11, E1, E1, f_E1, f_E1, eps, ne, grad_ne_E1, grad_ne_E1, -1, 1, 1);
+    getMii(M11, E1, E1, geo.f_E1, geo.f_E1, eps, grad_ne_E1, grad_ne_E1, -1, 1, 1);
     
     
+    rhs.resize(3);
+    boundaryRhs(edge, E1, grad_ne_E1, rhs.data());
+    return 0;
+}
+
+void DGSolvingSystem::boundaryRhs(const Edge &edge, const Element &E1, const double grad_ne_E1[3], double rhs[3])
+{
     double eps_int_e_gd = 0; // actually 2 * \epsilon * int_e(g_D) / |e|, 2 / |e| is not divided here since the normal vector ne is not unified
     for (int iver : E1.vertex) {
         if (iver == edge.vertex[0] || iver == edge.vertex[1])
-            eps_int_e_gd += prob->gd(mesh -> vertex[iver - 1].x, mesh -> vertex[iver - 1].y);
+            eps_int_e_gd += gdVertex[iver - 1];
     }
-    eps_int_e_gd *= eps;
+    eps_int_e_gd *= prob->epsilon;
     
-    rhs.resize(3);
     for (int i = 0; i < 3; i++) {
         int iver = E1.vertex[i];
         if (iver != edge.vertex[0] && iver != edge.vertex[1])
             rhs[i] = grad_ne_E1[i] * eps_int_e_gd;
         else
-            rhs[i] = grad_ne_E1[i] * eps_int_e_gd + prob->sigma0 / 2.0 * prob->gd(mesh -> vertex[iver - 1].x, mesh -> vertex[iver - 1].y);
+            rhs[i] = grad_ne_E1[i] * eps_int_e_gd + prob->sigma0 / 2.0 * gdVertex[iver - 1];
     }
-    return 0;
 }
 
 void DGSolvingSystem::addMiiToMA(VECMATRIX M, Element E1, Element E2)
 {
     for (int row = 0; row != M.size(); ++row)
         for (int col = 0; col != M[row].size(); ++col)
-            this -> addToMA(M[row][col], E1.dofIndex + row, E2.dofIndex + col);
+            this -> addToMA(assembleScale * M[row][col], E1.dofIndex + row, E2.dofIndex + col);
 }
 
 int DGSolvingSystem::assembleEdge(Edge edge)
@@ -443,13 +439,123 @@ int DGSolvingSystem::assembleEdge(Edge edge)
         addMiiToMA(M11, E1, E1);
         
         for (int i = 0; i < 3; i++)
-            rh[E1.dofIndex + i] += rhs[i];
+            rh[E1.dofIndex + i] += assembleScale * rhs[i];
     }
     
     
     return 0;
 }
 
+namespace {
+    // the elements and edges go through the kernels in batches of this size
+    const int Batch = 4096;
+}
+
+void DGSolvingSystem::assembleElements(const vector<int> &elements)
+{
+    const SimdKernels &kernels = simdKernels();
+    ElementLanes &lanes = elementLanes;
+    for (vector<int>::size_type first = 0; first < elements.size(); first += Batch) {
+        const int *batch = elements.data() + first;
+        int n = std::min<vector<int>::size_type>(Batch, elements.size() - first);
+        lanes.resize(n);
+        for (int k = 0; k < n; k++) {
+            const Element &ele = mesh -> element[batch[k] - 1];
+            const ElementGeometry &geo = elementGeometry[ele.index - 1];
+            for (int i = 0; i < 3; i++) {
+                lanes.grad[i][0][k] = geo.grad[i][0];
+                lanes.grad[i][1][k] = geo.grad[i][1];
+                lanes.f[i][k] = fVertex[ele.vertex[i] - 1];
+            }
+            lanes.detBE[k] = ele.detBE;
+        }
+        
+        kernels.elementBlocks(lanes);
+        
+        for (int k = 0; k < n; k++) {
+            const Element &ele = mesh -> element[batch[k] - 1];
+            for (int row = 0; row < 3; row++)
+                for (int col = 0; col < 3; col++)
+                    this -> addToMA(assembleScale * lanes.K[row][col][k], ele.dofIndex + row, ele.dofIndex + col);
+            for (int i = 0; i < 3; i++)
+                this -> rh[ele.dofIndex + i] += assembleScale * lanes.b[i][k];
+        }
+    }
+}
+
+void DGSolvingSystem::assembleEdges(const vector<int> &edges, bool assembled)
+{
+    const SimdKernels &kernels = simdKernels();
+    auto neighbors = [&](int iEdge) -> const vector<int> & {
+        return assembled ? assembledNeighbors[iEdge - 1] : mesh -> edge[iEdge - 1].neighborElement;
+    };
+    auto gatherNeighbor = [&](int iEle, const double f_E[3][2], vector<double> (&f)[3][2],
+                              vector<double> (&grad)[3][2], vector<double> &detBE, int l) {
+        const Element &ele = mesh -> element[iEle - 1];
+        const ElementGeometry &geo = elementGeometry[iEle - 1];
+        for (int i = 0; i < 3; i++)
+            for (int c = 0; c < 2; c++) {
+                f[i][c][l] = f_E[i][c];
+                grad[i][c][l] = geo.grad[i][c];
+            }
+        detBE[l] = ele.detBE;
+    };
+    auto addBlock = [&](const vector<double> (&M)[3][3], int l, const Element &E1, const Element &E2) {
+        for (int row = 0; row < 3; row++)
+            for (int col = 0; col < 3; col++)
+                this -> addToMA(assembleScale * M[row][col][l], E1.dofIndex + row, E2.dofIndex + col);
+    };
+    
+    for (vector<int>::size_type first = 0; first < edges.size(); first += Batch) {
+        const int *batch = edges.data() + first;
+        int n = std::min<vector<int>::size_type>(Batch, edges.size() - first);
+        int nInterior = 0;
+        for (int k = 0; k < n; k++)
+            nInterior += neighbors(batch[k]).size() == 2;
+        interiorLanes.resize(nInterior);
+        boundaryLanes.resize(n - nInterior);
+        
+        for (int k = 0, li = 0, lb = 0; k < n; k++) {
+            const vector<int> &nb = neighbors(batch[k]);
+            const EdgeGeometry &geo = edgeGeometry[batch[k] - 1];
+            bool interior = nb.size() == 2;
+            EdgeLanes &lanes = interior ? interiorLanes : boundaryLanes;
+            int l = interior ? li++ : lb++;
+            lanes.ne[0][l] = geo.ne[0];
+            lanes.ne[1][l] = geo.ne[1];
+            gatherNeighbor(nb[0], geo.f_E1, lanes.f1, lanes.grad1, lanes.detBE1, l);
+            if (interior)
+                gatherNeighbor(nb[1], geo.f_E2, lanes.f2, lanes.grad2, lanes.detBE2, l);
+        }
+        
+        kernels.interiorEdgeBlocks(interiorLanes, prob -> epsilon, penaltyOver6);
+        kernels.boundaryEdgeBlocks(boundaryLanes, prob -> epsilon, penaltyOver6);
+        
+        // in the order of the edges, as assembleEdge adds them
+        for (int k = 0, li = 0, lb = 0; k < n; k++) {
+            const vector<int> &nb = neighbors(batch[k]);
+            const Element &E1 = mesh -> element[nb[0] - 1];
+            if (nb.size() == 2) {
+                const Element &E2 = mesh -> element[nb[1] - 1];
+                addBlock(interiorLanes.M[0], li, E1, E1);
+                addBlock(interiorLanes.M[1], li, E1, E2);
+                addBlock(interiorLanes.M[2], li, E2, E1);
+                addBlock(interiorLanes.M[3], li, E2, E2);
+                li++;
+            } else {
+                addBlock(boundaryLanes.M[0], lb, E1, E1);
+                double grad_ne_E1[3], rhs[3];
+                for (int i = 0; i < 3; i++)
+                    grad_ne_E1[i] = boundaryLanes.gradNe1[i][lb];
+                boundaryRhs(mesh -> edge[batch[k] - 1], E1, grad_ne_E1, rhs);
+                for (int i = 0; i < 3; i++)
+                    this -> rh[E1.dofIndex + i] += assembleScale * rhs[i];
+                lb++;
+            }
+        }
+    }
+}
+
 int DGSolvingSystem::retrieve_dof_count_element_dofIndex(Mesh &mesh)
 {
     int dof(0);
@@ -463,77 +569,418 @@ int DGSolvingSystem::retrieve_dof_count_element_dofIndex(Mesh &mesh)
     return dof;
 }
 
+void DGSolvingSystem::updateVertexValues()
+{
+    int first = (int) fVertex.size(), n = (int) mesh -> vertex.size() - first;
+    if (n <= 0)
+        return;
+    vector<double> vx(n), vy(n);
+    for (int i = 0; i < n; i++) {
+        vx[i] = mesh -> vertex[first + i].x;
+        vy[i] = mesh -> vertex[first + i].y;
+    }
+    fVertex.resize(first + n);
+    gdVertex.resize(first + n);
+    trueSolVertex.resize(first + n);
+    prob -> fBatch(&vx[0], &vy[0], &fVertex[first], n);
+    prob -> gdBatch(&vx[0], &vy[0], &gdVertex[first], n);
+    prob -> trueSolBatch(&vx[0], &vy[0], &trueSolVertex[first], n);
+}
+
 void DGSolvingSystem::assembleStiff()
 {
+    updateVertexValues();
+    // a staged matrix cannot take contributions out, so it is assembled again in full
+    if (this -> dof > 0 && prob -> parameters.stagingMB <= 0) {
+        reassembleStiff();
+        return;
+    }
+    
 #ifdef __DGSOLVESYS_DEBUG
     cout << "start forming system" << endl;
 #endif
     
-    clock_t t = clock();
-    
+    PhaseTimer dofTimer(Phase::DofNumbering);
     this -> dof = retrieve_dof_count_element_dofIndex(*mesh); // get total dof
+    dofTimer.stop();
+    RunReport::setValue("dof", this -> dof);
+    RunReport::setValue("simd_lanes", simdKernels().lanes);
 #ifdef __DGSOLVESYS_DEBUG
     cout << " dof = " << this -> dof << endl;
+    cout << " element and edge kernels: " << simdKernels().name << ", " << simdKernels().lanes << " lanes" << endl;
 #endif
     
+    PhaseTimer elementTimer(Phase::ElementAssembly);
+    
     // initialize rh, ma
+    delete[] this -> rh;
     this -> rh = new double [this -> dof];
     memset(this -> rh, 0, (this -> dof) * sizeof(double));
-    this -> ma.resize(this -> dof);
+    beginStaging();
+    if (staging == nullptr)
+        this -> ma.resize(this -> dof);
     
     mesh -> calcDetBE(); //calculate det(B_E) for each element
+    computeGeometry();
     
     // assemble element integral related items
-    int k = 1;
-    for (auto it = mesh -> element.begin();
-         it != mesh -> element.end(); ++it, ++k) {
-        if (it -> reftype != constNonrefined)
-            continue;
-        
-        // #ifdef __DGSOLVESYS_DEBUG_LV2
-        //      cout << " assemble element " << k << endl;
-        // #endif
-        
-        assembleElement(*it);
-    }
-    t = clock() - t;
+    vector<int> leafElements, leafEdges;
+    for (Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            leafElements.push_back(ele.index);
+    for (Edge &ed : mesh -> edge)
+        if (ed.reftype == constNonrefined)
+            leafEdges.push_back(ed.index);
+    assembleElements(leafElements);
+    double t = elementTimer.stop();
     
 #ifdef __DGSOLVESYS_DEBUG
-    cout << "finish assembling element, t = "
-    << (double) t / CLOCKS_PER_SEC << "s"
-    << endl;
+    cout << "finish assembling element, t = " << t << "s" << endl;
 #endif
     
     
-    t = clock();
+    PhaseTimer edgeTimer(Phase::EdgeAssembly);
     
     // assemble edge integral related items
-    k = 1;
-    for (auto it = mesh -> edge.begin(); it != mesh -> edge.end(); ++it, ++k) {
-        if (it -> reftype != constNonrefined)
-            continue;
-        
-//         #ifdef __DGSOLVESYS_DEBUG_EDGE
-//              cout << " assemble edge " << k << endl;
-//         #endif
-        assembleEdge(*it);
-    }
+    assembleEdges(leafEdges);
+    
+    t = edgeTimer.stop();
     
-    t = clock() - t;
+    assembledElement.resize(mesh -> element.size());
+    for (Element &ele : mesh -> element)
+        assembledElement[ele.index - 1] = ele.reftype == constNonrefined;
+    assembledNeighbors.resize(mesh -> edge.size());
+    for (Edge &ed : mesh -> edge)
+        if (ed.reftype == constNonrefined)
+            assembledNeighbors[ed.index - 1] = ed.neighborElement;
     
 #ifdef __DGSOLVESYS_DEBUG
-    cout << "finish assembling edge, t = "
-    << (double) t / CLOCKS_PER_SEC << "s"
-    << endl;
+    cout << "finish assembling edge, t = " << t << "s" << endl;
 #endif
 #ifdef __DGSOLVESYS_DEBUG
     cout << "finish forming system" << endl << endl;
 #endif
+}
 
+// Each entry of ma stays in place with its value reset, so the pattern is
+// unchanged unless an entry that was zero before becomes nonzero.
+void DGSolvingSystem::reassembleValues()
+{
+    penaltyOver6 = prob->sigma0 / 6.0;
+    beginStaging();
+    for (auto &col : ma)
+        for (maColEle &entry : col)
+            entry.value = 0;
+    memset(this -> rh, 0, (this -> dof) * sizeof(double));
+    
+    vector<int> leafElements, leafEdges;
+    for (Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            leafElements.push_back(ele.index);
+    for (Edge &ed : mesh -> edge)
+        if (ed.reftype == constNonrefined)
+            leafEdges.push_back(ed.index);
+    
+    PhaseTimer elementTimer(Phase::ElementAssembly);
+    assembleElements(leafElements);
+    elementTimer.stop();
+    
+    PhaseTimer edgeTimer(Phase::EdgeAssembly);
+    assembleEdges(leafEdges);
+}
+
+// Refinement only adds elements and edges, so the elements and the neighbors of
+// the edges at the last assembly are still there to take the old contributions
+// out. The dof blocks of refined elements are handed to their children first.
+void DGSolvingSystem::reassembleStiff()
+{
+    PhaseTimer dofTimer(Phase::DofNumbering);
+    vector<int> removed, added, changedEdges, newEdges;
+    for (Element &ele : mesh -> element) {
+        bool wasLeaf = ele.index <= (int) assembledElement.size() && assembledElement[ele.index - 1];
+        bool isLeaf = ele.reftype == constNonrefined;
+        if (wasLeaf && !isLeaf)
+            removed.push_back(ele.index);
+        else if (!wasLeaf && isLeaf)
+            added.push_back(ele.index);
+    }
+    for (Edge &ed : mesh -> edge) {
+        bool wasLeaf = ed.index <= (int) assembledNeighbors.size() && !assembledNeighbors[ed.index - 1].empty();
+        bool isLeaf = ed.reftype == constNonrefined;
+        bool same = wasLeaf && isLeaf && assembledNeighbors[ed.index - 1] == ed.neighborElement;
+        if (wasLeaf && !same)
+            changedEdges.push_back(ed.index);
+        if (isLeaf && !same)
+            newEdges.push_back(ed.index);
+    }
+    if (added.size() < removed.size())
+        throw std::runtime_error("reassembly after coarsening is not supported");
+    dofTimer.stop();
+    
+    // take out the old contributions
+    PhaseTimer edgeTimer(Phase::EdgeAssembly);
+    assembleScale = -1;
+    assembleEdges(changedEdges, true);
+    assembleScale = 1;
+    edgeTimer.stop();
+    
+    PhaseTimer elementTimer(Phase::ElementAssembly);
+    assembleScale = -1;
+    assembleElements(removed);
+    assembleScale = 1;
+    
+    // drop the freed blocks from ma, their rows can only be in the columns of the old edge neighbors
+    vector<char> freed(dof, 0);
+    vector<int> freeBlocks;
+    for (int iEle : removed) {
+        Element &ele = mesh -> element[iEle - 1];
+        freeBlocks.push_back(ele.dofIndex);
+        for (int i = 0; i < ele.localDof; i++) {
+            freed[ele.dofIndex + i] = 1;
+            rh[ele.dofIndex + i] = 0;
+        }
+    }
+    for (int iEdge : changedEdges)
+        for (int iEle : assembledNeighbors[iEdge - 1]) {
+            Element &ele = mesh -> element[iEle - 1];
+            for (int col = ele.dofIndex; col < ele.dofIndex + ele.localDof; col++) {
+                if (freed[col])
+                    ma[col].clear();
+                else
+                    ma[col].remove_if([&freed](const maColEle &e) { return freed[e.row] != 0; });
+            }
+        }
+    elementTimer.stop();
+    
+    // number the new leaves, in the freed blocks first
+    PhaseTimer numberTimer(Phase::DofNumbering);
+    int oldDof = dof;
+    vector<int>::size_type k = 0;
+    for (int iEle : added) {
+        Element &ele = mesh -> element[iEle - 1];
+        ele.localDof = LocalDimension;
+        if (k < freeBlocks.size())
+            ele.dofIndex = freeBlocks[k++];
+        else {
+            ele.dofIndex = dof;
+            dof += LocalDimension;
+        }
+    }
+    double *newRh = new double [dof];
+    memcpy(newRh, rh, oldDof * sizeof(double));
+    memset(newRh + oldDof, 0, (dof - oldDof) * sizeof(double));
+    delete[] rh;
+    rh = newRh;
+    ma.resize(dof);
+    numberTimer.stop();
+    RunReport::setValue("dof", this -> dof);
+    
+    // add the new contributions
+    PhaseTimer addElementTimer(Phase::ElementAssembly);
+    mesh -> calcDetBE();
+    computeGeometry(added, newEdges); // after the old contributions of changed edges are out
+    assembleElements(added);
+    addElementTimer.stop();
+    
+    PhaseTimer addEdgeTimer(Phase::EdgeAssembly);
+    assembleEdges(newEdges);
+    addEdgeTimer.stop();
+    
+    assembledElement.resize(mesh -> element.size());
+    for (int iEle : removed)
+        assembledElement[iEle - 1] = 0;
+    for (int iEle : added)
+        assembledElement[iEle - 1] = 1;
+    assembledNeighbors.resize(mesh -> edge.size());
+    for (int iEdge : changedEdges)
+        assembledNeighbors[iEdge - 1].clear();
+    for (int iEdge : newEdges)
+        assembledNeighbors[iEdge - 1] = mesh -> edge[iEdge - 1].neighborElement;
+    
+#ifdef __DGSOLVESYS_DEBUG
+    cout << "reassembled " << added.size() << " elements and " << newEdges.size() << " edges, dof = " << dof << endl;
+#endif
+}
+
+// u_t - Laplace u = f with g_D and f constant in time, from u = 0. The matrix A and the load b of
+// assembleStiff do not change, so ma becomes M + theta dt A, which is factored in the first step and
+// kept; each step then solves (M + theta dt A) (u^{n+1} - u^n) = dt (b - A u^n) by triangular solves
+void DGSolvingSystem::solveTransient()
+{
+    const paramstruct &param = prob -> parameters;
+    if (staging != nullptr)
+        throw std::runtime_error("time stepping needs the matrix in memory, set the out-of-core budget to 0");
+    const double dt = param.timeStep, theta = param.timeTheta;
+    cout << "time stepping to t = " << param.timeSteps * dt << " in " << param.timeSteps << " steps, theta = " << theta << endl;
+    
+    // A in CSC for the right-hand sides
+    PhaseTimer cscTimer(Phase::CSCConversion);
+    vector<int> Ap(dof + 1, 0), Ai;
+    vector<double> Ax, b(rh, rh + dof);
+    for (int col = 0; col < dof; col++) {
+        for (const maColEle &entry : ma[col]) {
+            Ai.push_back(entry.row);
+            Ax.push_back(entry.value);
+        }
+        Ap[col + 1] = (int) Ai.size();
+    }
+    cscTimer.stop();
+    
+    // the mass matrix only adds to the diagonal blocks, so the pattern stays
+    PhaseTimer massTimer(Phase::ElementAssembly);
+    for (auto &col : ma)
+        for (maColEle &entry : col)
+            entry.value *= theta * dt;
+    for (Element &ele : mesh -> element) {
+        if (ele.reftype != constNonrefined)
+            continue;
+        VECMATRIX mass = elementMass(ele);
+        for (int row = 0; row < LocalDimension; row++)
+            for (int col = 0; col < LocalDimension; col++)
+                addToMA(mass[row][col], ele.dofIndex + row, ele.dofIndex + col);
+    }
+    massTimer.stop();
+    
+    keepFactorization = true;
+    if (solver != nullptr)
+        solver -> setKeepFactorization(true);
+    vector<double> u(dof, 0), r(dof), du;
+    for (int step = 1; step <= param.timeSteps; step++) {
+        PhaseTimer rhsTimer(Phase::Solve);
+        r = b;
+        for (int col = 0; col < dof; col++)
+            for (int k = Ap[col]; k < Ap[col + 1]; k++)
+                r[Ai[k]] -= Ax[k] * u[col];
+        for (double &ri : r)
+            ri *= dt;
+        rhsTimer.stop();
+        
+        if (step == 1) {
+            memcpy(rh, r.data(), dof * sizeof(double));
+            solveSparse();
+            if (solver == nullptr)
+                throw std::runtime_error("time stepping needs UMFPACK or SuperLU");
+            du.swap(x);
+        } else
+            du = solver -> solve(r);
+        
+        double change(0);
+        for (int i = 0; i < dof; i++) {
+            u[i] += du[i];
+            change = std::max(change, fabs(du[i]));
+        }
+        if (param.outputEvery > 0 && step % param.outputEvery == 0) {
+            cout << "step " << step << ", t = " << step * dt << ", max change = " << change << endl;
+            writer.wait(); // the last snapshot is written before it is overwritten
+            snapshot = u;
+            writer.start(*mesh, snapshot, param.meshFilename + ".step" + std::to_string(step),
+                         param.fprintResults ? param.fprintResults : SolutionWriter::Text);
+        }
+    }
+    writer.wait();
+    
+    x.swap(u);
+    memcpy(rh, b.data(), dof * sizeof(double));
+    RunReport::setValue("time_steps", param.timeSteps);
+    RunReport::setValue("final_time", param.timeSteps * dt);
+}
+
+// -Laplace u + r(u) = f: with A and b of assembleStiff and the reaction lumped at the vertices as f is,
+// R_i = r(u_i) |E| / 3, Newton solves J du = -F for F = A u + R(u) - b and J = A + diag(r'(u_i) |E| / 3).
+// The Jacobian only changes on the diagonal, so its values are set on the pattern of ma and the solver
+// keeps its symbolic factorization. With lagJacobian > 0 a factored Jacobian is reused while the residual
+// at least halves in each iteration, up to lagJacobian times.
+void DGSolvingSystem::solveNonlinear()
+{
+    const paramstruct &param = prob -> parameters;
+    if (staging != nullptr)
+        throw std::runtime_error("Newton's method needs the matrix in memory, set the out-of-core budget to 0");
+    
+    // A with the rows of each column sorted as the solvers sort them, so its values line up with ma
+    PhaseTimer cscTimer(Phase::CSCConversion);
+    vector<int> Ap(dof + 1, 0), Ai;
+    vector<double> Ax, b(rh, rh + dof);
+    for (int col = 0; col < dof; col++) {
+        ma[col].sort([](const maColEle &t1, const maColEle &t2) { return t1.row < t2.row; });
+        for (const maColEle &entry : ma[col]) {
+            Ai.push_back(entry.row);
+            Ax.push_back(entry.value);
+        }
+        Ap[col + 1] = (int) Ai.size();
+    }
+    cscTimer.stop();
+    
+    vector<double> lumped(dof, 0);
+    for (Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            for (int i = 0; i < LocalDimension; i++)
+                lumped[ele.dofIndex + i] = ele.detBE / 6.0;
+    
+    keepFactorization = param.lagJacobian > 0;
+    if (solver != nullptr)
+        solver -> setKeepFactorization(keepFactorization);
+    vector<double> u(dof, 0), r(dof), dr(dof), F(dof), du;
+    double norm0(0), lastNorm(0), norm(0);
+    int iteration = 0, factorizations = 0, reuses = 0;
+    for (; ; iteration++) {
+        PhaseTimer residualTimer(Phase::ElementAssembly);
+        prob -> reactionBatch(u.data(), r.data(), dr.data(), dof);
+        for (int i = 0; i < dof; i++)
+            F[i] = lumped[i] * r[i] - b[i];
+        for (int col = 0; col < dof; col++)
+            for (int k = Ap[col]; k < Ap[col + 1]; k++)
+                F[Ai[k]] += Ax[k] * u[col];
+        norm = 0;
+        for (double Fi : F)
+            norm += Fi * Fi;
+        norm = sqrt(norm);
+        residualTimer.stop();
+        if (iteration == 0)
+            norm0 = norm;
+        cout << "Newton iteration " << iteration << ", residual = " << norm << endl;
+        if (norm <= param.newtonTol * norm0 || iteration == param.maxNewton)
+            break;
+        
+        for (double &Fi : F)
+            Fi = -Fi;
+        if (solver != nullptr && reuses < param.lagJacobian && norm <= 0.5 * lastNorm) {
+            du = solver -> solve(F);
+            ++reuses;
+        } else {
+            PhaseTimer jacobianTimer(Phase::ElementAssembly);
+            for (int col = 0; col < dof; col++) {
+                int k = Ap[col];
+                for (maColEle &entry : ma[col])
+                    entry.value = Ax[k++];
+            }
+            for (int i = 0; i < dof; i++)
+                addToMA(lumped[i] * dr[i], i, i);
+            memcpy(rh, F.data(), dof * sizeof(double));
+            jacobianTimer.stop();
+            solveSparse();
+            if (solver == nullptr)
+                throw std::runtime_error("Newton's method needs UMFPACK or SuperLU");
+            du.swap(x);
+            ++factorizations;
+            reuses = 0;
+        }
+        for (int i = 0; i < dof; i++)
+            u[i] += du[i];
+        lastNorm = norm;
+    }
+    if (norm > param.newtonTol * norm0)
+        cout << "Newton's method did not converge in " << param.maxNewton << " iterations" << endl;
+    
+    x.swap(u);
+    memcpy(rh, b.data(), dof * sizeof(double));
+    RunReport::setValue("newton_iterations", iteration);
+    RunReport::setValue("newton_residual", norm);
+    RunReport::setValue("jacobian_factorizations", factorizations);
 }
 
 int DGSolvingSystem::consoleOutput()
 {
+    updateVertexValues();
     std::vector<Element>::iterator it;
     int k(0);
     for (it = mesh -> element.begin(); it != mesh -> element.end(); it++) {
@@ -545,7 +992,7 @@ int DGSolvingSystem::consoleOutput()
                 cout << mesh -> vertex[ver - 1].x << " " << mesh -> vertex[ver - 1].y << " " << this -> x[it -> dofIndex + (k++)] << std::endl;
             else
                 cout << mesh -> vertex[ver - 1].x << " " << mesh -> vertex[ver - 1].y << " "
-                << prob->gd(mesh -> vertex[ver - 1].x, mesh -> vertex[ver - 1].y) << std::endl;
+                << gdVertex[ver - 1] << std::endl;
     }
     
     return 0;
@@ -553,30 +1000,13 @@ int DGSolvingSystem::consoleOutput()
 
 int DGSolvingSystem::fileOutput()
 {
-    std::ofstream fout((prob->parameters.meshFilename + ".output").c_str());
-    
-    std::vector<Element>::iterator it;
-    int k(0);
-    for (it = mesh -> element.begin(); it != mesh -> element.end(); it++) {
-        if (it -> reftype != constNonrefined) {
-            continue;
-        }
-        k = 0;
-        for (int ver : it -> vertex) {
-            // if (mesh -> vertex[ver - 1].bctype == 0)
-            fout << mesh -> vertex[ver - 1].x << " " << mesh -> vertex[ver - 1].y << " " << this -> x[it -> dofIndex + (k++)] << std::endl;
-            // else
-            //     fout << mesh -> vertex[ver - 1].x << " " << mesh -> vertex[ver - 1].y << " "
-            //          << prob.gd(mesh -> vertex[ver - 1].x, mesh -> vertex[ver - 1].y) << std::endl;
-        }
-    }
-    
-    
+    writer.start(*mesh, x, prob->parameters.meshFilename, prob->parameters.fprintResults);
     return 0;
 }
 
 void DGSolvingSystem::output()
 {
+    PhaseTimer outputTimer(Phase::Output);
     if (prob->parameters.printResults)
         consoleOutput();
     if (prob->parameters.fprintResults)
@@ -584,52 +1014,218 @@ void DGSolvingSystem::output()
     
     BasicSolvingSystem::output();
     
+    outputTimer.stop();
+    
     if (prob->parameters.cprintError) {
         double errL2(0), errH1(0);
         computeError(errL2, errH1);
+        RunReport::setValue("errL2", errL2);
+        RunReport::setValue("errH1", errH1);
         std::cout << "error in L2 norm = " << errL2 << std::endl
                   << "error in H1 norm = " << errH1 << std::endl;
     }
     
+    writer.wait(); // the file output overlaps with the error computation
 }
 
 void DGSolvingSystem::computeError(double &errL2, double &errH1)
 {
-    std::ofstream fout((prob->parameters.meshFilename + ".err").c_str());
+    PhaseTimer timer(Phase::ErrorComputation);
+    std::ofstream fout;
+    std::unique_ptr<FormatBuffer> residual;
+    if (prob->parameters.fprintError) {
+        fout.open((prob->parameters.meshFilename + ".err").c_str());
+        residual.reset(new FormatBuffer(&fout));
+    }
     
+    errorSquares(x.data(), 0, (int) x.size(), errL2, errH1, residual.get());
+    errL2 = sqrt(errL2);
+    errH1 = sqrt(errH1);
+}
+
+namespace {
+    // Dunavant's rule of degree 5, barycentric coordinates and weights summing to 1
+    const int QuadPoints = 7;
+    const double QuadLambda[QuadPoints][3] = {
+        {1.0 / 3, 1.0 / 3, 1.0 / 3},
+        {0.059715871789770, 0.470142064105115, 0.470142064105115},
+        {0.470142064105115, 0.059715871789770, 0.470142064105115},
+        {0.470142064105115, 0.470142064105115, 0.059715871789770},
+        {0.797426985353087, 0.101286507323456, 0.101286507323456},
+        {0.101286507323456, 0.797426985353087, 0.101286507323456},
+        {0.101286507323456, 0.101286507323456, 0.797426985353087}
+    };
+    const double QuadWeight[QuadPoints] = {
+        0.225, 0.132394152788506, 0.132394152788506, 0.132394152788506,
+        0.125939180544827, 0.125939180544827, 0.125939180544827
+    };
+}
+
+// the elements go in chunks: the quadrature points and the sums of each element in parallel, the true
+// solution in one batch per chunk as problems need not be thread-safe, and the sums added in element order
+// so that the result does not depend on the number of threads
+void DGSolvingSystem::errorSquares(const double *xLocal, int firstDof, int numDofs, double &errL2, double &errH1, FormatBuffer *residual)
+{
+    updateVertexValues();
+    vector<int> leaves;
+    for (const Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined && ele.dofIndex >= firstDof && ele.dofIndex < firstDof + numDofs)
+            leaves.push_back(ele.index);
+    
+    const int chunk = 8192;
+    vector<double> px, py, u, ux, uy, sumL2, sumH1;
     errL2 = 0;
     errH1 = 0;
-    for (Element iEle : mesh -> element) {
-        if (iEle.reftype != constNonrefined)
-            continue;
-        Vertex &v1 = mesh -> vertex[iEle.vertex[0] - 1];
-        Vertex &v2 = mesh -> vertex[iEle.vertex[1] - 1];
-        Vertex &v3 = mesh -> vertex[iEle.vertex[2] - 1];
-        double x1(v1.x), y1(v1.y), x2(v2.x), y2(v2.y), x3(v3.x), y3(v3.y);
-        double p1(0), p2(0), p3(0);
-        double r1(0), r2(0), r3(0);
+    for (vector<int>::size_type first = 0; first < leaves.size(); first += chunk) {
+        const int *chunkLeaves = leaves.data() + first;
+        int m = std::min<vector<int>::size_type>(chunk, leaves.size() - first), np = m * QuadPoints;
+        px.resize(np);
+        py.resize(np);
+        u.resize(np);
+        ux.resize(np);
+        uy.resize(np);
+        sumL2.resize(m);
+        sumH1.resize(m);
         
-        if (v1.bctype > 0) {
-            p1 = this -> x[iEle.dofIndex];
-            r1 = prob->trueSol(x1, y1) - p1;
-        }
-        if (v2.bctype > 0) {
-            p2 = this -> x[iEle.dofIndex + 1];
-            r2 = prob->trueSol(x2, y2) - p2;
+        parallelFor(m, [&](int k) {
+            const Element &ele = mesh -> element[chunkLeaves[k] - 1];
+            const Vertex &v1 = mesh -> vertex[ele.vertex[0] - 1];
+            const Vertex &v2 = mesh -> vertex[ele.vertex[1] - 1];
+            const Vertex &v3 = mesh -> vertex[ele.vertex[2] - 1];
+            for (int q = 0; q < QuadPoints; q++) {
+                const double *l = QuadLambda[q];
+                px[k * QuadPoints + q] = l[0] * v1.x + l[1] * v2.x + l[2] * v3.x;
+                py[k * QuadPoints + q] = l[0] * v1.y + l[1] * v2.y + l[2] * v3.y;
+            }
+        });
+        prob -> trueSolBatch(px.data(), py.data(), u.data(), np);
+        prob -> trueSolGradBatch(px.data(), py.data(), ux.data(), uy.data(), np);
+        
+        parallelFor(m, [&](int k) {
+            const Element &ele = mesh -> element[chunkLeaves[k] - 1];
+            const ElementGeometry &geo = elementGeometry[ele.index - 1];
+            const double *uh = xLocal + ele.dofIndex - firstDof;
+            double gx = (uh[0] * geo.grad[0][0] + uh[1] * geo.grad[1][0] + uh[2] * geo.grad[2][0]) / geo.det;
+            double gy = (uh[0] * geo.grad[0][1] + uh[1] * geo.grad[1][1] + uh[2] * geo.grad[2][1]) / geo.det;
+            double l2(0), h1(0);
+            for (int q = 0; q < QuadPoints; q++) {
+                const double *l = QuadLambda[q];
+                int p = k * QuadPoints + q;
+                double e = u[p] - (l[0] * uh[0] + l[1] * uh[1] + l[2] * uh[2]);
+                double ex = ux[p] - gx, ey = uy[p] - gy;
+                l2 += QuadWeight[q] * e * e;
+                h1 += QuadWeight[q] * (ex * ex + ey * ey);
+            }
+            sumL2[k] = l2 * ele.detBE / 2;
+            sumH1[k] = h1 * ele.detBE / 2;
+        });
+        
+        for (int k = 0; k < m; k++) {
+            errL2 += sumL2[k];
+            errH1 += sumH1[k];
         }
-        if (v3.bctype > 0) {
-            p3 = this -> x[iEle.dofIndex + 2];
-            r3 = prob->trueSol(x3, y3) - p3;
+        if (residual == nullptr)
+            continue;
+        for (int k = 0; k < m; k++) {
+            const Element &ele = mesh -> element[chunkLeaves[k] - 1];
+            for (int i = 0; i < 3; i++) {
+                const Vertex &v = mesh -> vertex[ele.vertex[i] - 1];
+                *residual << v.x << ' ' << v.y << ' ' << trueSolVertex[ele.vertex[i] - 1] - xLocal[ele.dofIndex - firstDof + i] << '\n';
+            }
         }
-        errL2 += (r1 * r1 + r2 * r2 + r3 * r3) * iEle.detBE / 6.0;
+    }
+}
+
+double DGSolvingSystem::solutionAt(Element &ele, double px, double py, double &gx, double &gy)
+{
+    double x1(mesh -> vertex[ele.vertex[0] - 1].x), y1(mesh -> vertex[ele.vertex[0] - 1].y);
+    double u1(this -> x[ele.dofIndex]), u2(this -> x[ele.dofIndex + 1]), u3(this -> x[ele.dofIndex + 2]);
+    
+    const ElementGeometry &geo = elementGeometry[ele.index - 1];
+    gx = (u1 * geo.grad[0][0] + u2 * geo.grad[1][0] + u3 * geo.grad[2][0]) / geo.det;
+    gy = (u1 * geo.grad[0][1] + u2 * geo.grad[1][1] + u3 * geo.grad[2][1]) / geo.det;
+    return u1 + gx * (px - x1) + gy * (py - y1);
+}
+
+// eta_E^2 = h_E^2 ||f||_E^2 + 1/2 sum over interior edges (h_e ||[grad u_h . n]||_e^2 + sigma0 / h_e ||[u_h]||_e^2)
+//         + sum over boundary edges sigma0 / h_e ||u_h - g_D||_e^2, f + Laplace u_h = f for linear u_h
+void DGSolvingSystem::estimateError(vector<double> &eta2)
+{
+    PhaseTimer timer(Phase::ErrorEstimation);
+    eta2.assign(mesh -> element.size(), 0);
+    updateVertexValues();
+    
+    for (Element &ele : mesh -> element) {
+        if (ele.reftype != constNonrefined)
+            continue;
+        Vertex &v1 = mesh -> vertex[ele.vertex[0] - 1];
+        Vertex &v2 = mesh -> vertex[ele.vertex[1] - 1];
+        Vertex &v3 = mesh -> vertex[ele.vertex[2] - 1];
+        double hE = std::max(std::max(dist(v1.x, v1.y, v2.x, v2.y), dist(v2.x, v2.y, v3.x, v3.y)), dist(v3.x, v3.y, v1.x, v1.y));
+        double f1(fVertex[ele.vertex[0] - 1]), f2(fVertex[ele.vertex[1] - 1]), f3(fVertex[ele.vertex[2] - 1]);
+        eta2[ele.index - 1] += hE * hE * (f1 * f1 + f2 * f2 + f3 * f3) * ele.detBE / 6.0;
+    }
+    
+    double gx1, gy1, gx2, gy2;
+    for (Edge &ed : mesh -> edge) {
+        if (ed.reftype != constNonrefined)
+            continue;
+        Vertex &a = mesh -> vertex[ed.vertex[0] - 1];
+        Vertex &b = mesh -> vertex[ed.vertex[1] - 1];
+        double he = dist(a.x, a.y, b.x, b.y);
+        Element &E1 = mesh -> element[ed.neighborElement[0] - 1];
+        double da = solutionAt(E1, a.x, a.y, gx1, gy1);
+        double db = solutionAt(E1, b.x, b.y, gx1, gy1);
         
-        fout << v1.x << " " << v1.y << " " << r1 << endl
-        << v2.x << " " << v2.y << " " << r2 << endl
-        << v3.x << " " << v3.y << " " << r3 << endl;
+        if (ed.neighborElement.size() == 1) {
+            da -= gdVertex[ed.vertex[0] - 1];
+            db -= gdVertex[ed.vertex[1] - 1];
+            // ||d||_e^2 = |e| / 3 (d_a^2 + d_a d_b + d_b^2) for linear d
+            eta2[E1.index - 1] += prob -> sigma0 / 3.0 * (da * da + da * db + db * db);
+            continue;
+        }
         
-        errH1 += (  pow(r1 * (y2 - y3), 2) + pow(r2 * (y3 - y1), 2) + pow(r3 * (y1 - y2), 2)
-                  + pow(r1 * (x3 - x2), 2) + pow(r2 * (x1 - x3), 2) + pow(r3 * (x2 - x1), 2)  ) / 2.0 / iEle.detBE;
+        Element &E2 = mesh -> element[ed.neighborElement[1] - 1];
+        da -= solutionAt(E2, a.x, a.y, gx2, gy2);
+        db -= solutionAt(E2, b.x, b.y, gx2, gy2);
+        double jumpFlux = ((gx1 - gx2) * (b.y - a.y) + (gy1 - gy2) * (a.x - b.x)) / he;
+        double eta2e = he * he * jumpFlux * jumpFlux + prob -> sigma0 / 3.0 * (da * da + da * db + db * db);
+        eta2[E1.index - 1] += eta2e / 2;
+        eta2[E2.index - 1] += eta2e / 2;
     }
-    errL2 = sqrt(errL2);
-    errH1 = sqrt(errH1);
-}
\ No newline at end of file
+}
+
+bool DGSolvingSystem::refineAdaptive(int refineLevel)
+{
+    vector<double> eta2;
+    estimateError(eta2);
+    
+    double total(0);
+    vector<int> order;
+    for (Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined) {
+            total += eta2[ele.index - 1];
+            order.push_back(ele.index);
+        }
+    RunReport::setValue("eta", sqrt(total));
+    cout << "dof = " << dof << ", error estimate = " << sqrt(total) << endl;
+    if (sqrt(total) <= prob -> parameters.adaptiveTol)
+        return false;
+    
+    // Doerfler marking, the fewest elements that hold theta of the estimate
+    std::stable_sort(order.begin(), order.end(), [&eta2](int i, int j) { return eta2[i - 1] > eta2[j - 1]; });
+    vector<int> marked;
+    double sum(0);
+    for (int iEle : order) {
+        if (sum >= prob -> parameters.theta * total)
+            break;
+        marked.push_back(iEle);
+        sum += eta2[iEle - 1];
+    }
+    
+    mesh -> refineElements(marked, refineLevel);
+#ifdef __DGSOLVESYS_DEBUG
+    cout << " refined " << marked.size() << " of " << order.size() << " elements" << endl;
+#endif
+    return true;
+}
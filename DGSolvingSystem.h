@@ -15,44 +15,102 @@
 
 #include "BasicSolvingSystem.h"
 #include "DGProblem.h"
+#include "SolutionWriter.h"
+#include "FormatBuffer.h"
+#include "SimdKernels.h"
+
+// grad[i] = detBE * gradient of the basis function of vertex i, det is signed, detBE = |det|
+struct ElementGeometry {
+    double grad[3][2];
+    double det;
+};
+
+// ne = n_e^* and the trace tables f_E1, f_E2 of calc_ne_and_f_on_edge, f_E2 only on interior edges;
+// f_E[i][k] is the basis function of vertex i of the element at vertex k of the edge
+struct EdgeGeometry {
+    double ne[2];
+    double f_E1[3][2], f_E2[3][2];
+};
 
 class DGSolvingSystem: public BasicSolvingSystem {
 protected:
     const int LocalDimension = 3;
     double penaltyOver6;
+    double assembleScale; // 1 to add contributions to ma and rh, -1 to take them out
+    
+    // leaf elements and the neighbors of leaf edges at the last assembly
+    std::vector<char> assembledElement;
+    std::vector< std::vector<int> > assembledNeighbors;
+    
+    // f, g_D and the true solution at each mesh vertex, by vertex index - 1
+    std::vector<double> fVertex, gdVertex, trueSolVertex;
+    void updateVertexValues(); // evaluate the coefficients at the vertices added since the last call
+    
+    // geometry of the leaf elements and edges, by index - 1; an edge keeps the geometry of
+    // its neighbors at the last assembly until it is assembled again
+    std::vector<ElementGeometry> elementGeometry;
+    std::vector<EdgeGeometry> edgeGeometry;
+    void computeGeometry(const std::vector<int> &elements, const std::vector<int> &edges); // in parallel, after calcDetBE
+    void computeGeometry(); // of all leaf elements and edges
     
     int retrieve_dof_count_element_dofIndex(Mesh &mesh); // assign dof to each element and return the total dof
-    double innerProduct(std::vector<double> x, std::vector<double> y); // the inner product of two two-dimensional vector
+    double innerProduct(const double x[2], const double y[2]); // the inner product of two two-dimensional vector
     double dist(double x1, double y1, double x2, double y2);
-    int vertexOnEdge(Vertex ver, Vertex v1, Vertex v2); // if ver is on the line of edge, edge is given by v1 and v2
-    double penaltyTerm(Edge edge, int index_E1, int index_E2, int iver, int jver, VECMATRIX f_E1, VECMATRIX f_E2);
+    double penaltyTerm(int iver, int jver, const double f_E1[3][2], const double f_E2[3][2]);
     
     VECMATRIX elementInteg(Element ele);
+    VECMATRIX elementMass(Element ele); // exact for the linear basis
     std::vector<double> elementIntegRhs(Element ele);
     int assembleElement(Element ele);
     
-    int calc_ne_and_f_on_edge(Edge edge, std::vector<double> &ne, VECMATRIX &integ_e);
-    int calc_ne_and_f_on_edge(Edge edge, std::vector<double> &ne, VECMATRIX &f_E1, VECMATRIX &f_E2);
+    bool isSide(const Edge &edge, const Element &E); // both vertices of edge are vertices of E
+    // the trace table of E on edge, returning the local vertex of E opposite to edge
+    int sideTrace(const Edge &edge, const Element &E, double f_E[3][2]);     // edge is a side of E
+    int hangingTrace(const Edge &edge, const Element &E, double f_E[3][2]);  // edge lies on a side of E
+    void interiorNormal(const Edge &edge, const Element &E1, int opposite, double ne[2]);
+    int calc_ne_and_f_on_edge(const Edge &edge, double ne[2], double f_E1[3][2]);
+    int calc_ne_and_f_on_edge(const Edge &edge, double ne[2], double f_E1[3][2], double f_E2[3][2]);
+    void grad_ne(const Element &E, const double ne[2], double grad_ne_E[3]); // \nabla \phi_i^E \cdot ne
     
     void initM(VECMATRIX &M11, VECMATRIX &M12, VECMATRIX &M21, VECMATRIX &M22, int dofE1, int dofE2);
     void initM(VECMATRIX &M11, int dofE1);
 
-    int getMii(Edge edge, VECMATRIX &M, Element E1, Element E2, VECMATRIX f_E1, VECMATRIX f_E2,
-               double eps, std::vector<double> ne, std::vector<double> grad_ne_E1, std::vector<double> grad_ne_E2,
+    int getMii(VECMATRIX &M, const Element &E1, const Element &E2, const double f_E1[3][2], const double f_E2[3][2],
+               double eps, const double grad_ne_E1[3], const double grad_ne_E2[3],
                int sign1, int sing2, int sing3);
     void addMiiToMA(VECMATRIX M, Element E1, Element E2);
     int edgeInteg(Edge edge, VECMATRIX &M11, VECMATRIX &M12, VECMATRIX &M21, VECMATRIX &M22);
     int edgeInteg(Edge edge, VECMATRIX &M11, std::vector<double> &rhs);
+    void boundaryRhs(const Edge &edge, const Element &E1, const double grad_ne_E1[3], double rhs[3]); // of edgeInteg on a boundary edge
     int assembleEdge(Edge edge);
     
+    // assembleElement and assembleEdge of each in turn, with the kernels of SimdKernels on batches of them;
+    // the edges with their neighbors at the last assembly if assembled
+    ElementLanes elementLanes;
+    EdgeLanes interiorLanes, boundaryLanes;
+    void assembleElements(const std::vector<int> &elements);
+    void assembleEdges(const std::vector<int> &edges, bool assembled = false);
+    void reassembleStiff(); // update ma and rh for the elements and edges changed by refinement
+    
     void computeError(double &errL2, double &errH1); // compute error in L2 and H1 norm
+    // squared L2 and H1 errors of the leaf elements with dofIndex in [firstDof, firstDof + numDofs), whose
+    // solution is xLocal[dofIndex - firstDof]; the errors at their vertices are written to residual if given
+    void errorSquares(const double *xLocal, int firstDof, int numDofs, double &errL2, double &errH1, FormatBuffer *residual);
+    double solutionAt(Element &ele, double px, double py, double &gx, double &gy); // value and gradient of the solution on ele
+    void estimateError(std::vector<double> &eta2); // residual error indicator squared of each leaf element
     
     int consoleOutput();  // output the result in console
-    int fileOutput();     // output the result in file *.output
+    SolutionWriter writer;
+    std::vector<double> snapshot; // the solution of a time step while writer writes it
+    int fileOutput();     // start writing the result to file in the background, *.output, *.bin or *.vtu
 public:
     DGSolvingSystem(Mesh* m, Problem* p);
-    void assembleStiff(); // list-stored stiffness matrix saved in ma
+    void assembleStiff(); // list-stored stiffness matrix saved in ma, after refinement only the changes are assembled
+    void reassembleValues(); // assemble again for new epsilon and sigma0 on the same mesh and dofs
     void output();      // output the result
+    bool refineAdaptive(int refineLevel); // estimate, mark and refine, false once the estimate is below tolerance
+    void solveTransient(); // theta-scheme time steps after assembleStiff, factoring once
+    void solveNonlinear(); // Newton iterations after assembleStiff on the pattern of ma
 };
 
 
@@ -7,6 +7,7 @@
 //
 
 #include "DGSolvingSystemMPI.h"
+#include "MPIFile.h"
 
 using std::vector;
 using std::cout;
@@ -14,16 +15,16 @@ using std::endl;
 
 void DGSolvingSystemMPI::solveSparse() // now only solve with SuperLUDist
 {
-    LinearSolver *ls = nullptr;
-    if (prob -> parameters.solPack == SolPack::SuperLUDist)
-        ls = new SuperLUDISTSolver(ma, dof, rh, grid, m_loc, fst_row);
+    delete solver; // kept after the solve for the matrix output
+    solver = nullptr;
+    if (prob -> parameters.solPack == SolPack::SuperLUDist || prob -> parameters.solPack == SolPack::Auto) { // the only distributed one
+        solver = new SuperLUDISTSolver(ma, dof, rh, grid, m_loc, fst_row);
+        solver -> setPrintStatistics(prob -> parameters.solverStats != 0);
+    }
     // else havent implemented yet, need to gather ma and rh in order to solve with non-distributed solver
 
-    if (ls != nullptr)
-    {
-        x = ls -> solveSparse();
-        delete ls;
-    }
+    if (solver != nullptr)
+        x = solver -> solveSparse();
 }
 
 int DGSolvingSystemMPI::assembleElementMPI(Element ele)
@@ -104,32 +105,11 @@ int DGSolvingSystemMPI::edgeIntegMPI(Edge edge, VECMATRIX &M11, VECMATRIX &M12,
     Element &E1 = mesh -> element[edge.neighborElement[0] - 1];
     Element &E2 = mesh -> element[edge.neighborElement[1] - 1];
     
-    double E1_x1(mesh -> vertex[ E1.vertex[0] - 1].x),
-    E1_x2(mesh -> vertex[ E1.vertex[1] - 1].x),
-    E1_x3(mesh -> vertex[ E1.vertex[2] - 1].x),
-    E1_y1(mesh -> vertex[ E1.vertex[0] - 1].y),
-    E1_y2(mesh -> vertex[ E1.vertex[1] - 1].y),
-    E1_y3(mesh -> vertex[ E1.vertex[2] - 1].y);
-    double E2_x1(mesh -> vertex[ E2.vertex[0] - 1].x),
-    E2_x2(mesh -> vertex[ E2.vertex[1] - 1].x),
-    E2_x3(mesh -> vertex[ E2.vertex[2] - 1].x),
-    E2_y1(mesh -> vertex[ E2.vertex[0] - 1].y),
-    E2_y2(mesh -> vertex[ E2.vertex[1] - 1].y),
-    E2_y3(mesh -> vertex[ E2.vertex[2] - 1].y);
-    
-    vector<double> ne; // actually n_e^* as in the report
-    VECMATRIX f_E1, f_E2;
-    calc_ne_and_f_on_edge(edge, ne, f_E1, f_E2); // normal vector, not unit, actualy |e| / 4 * n_e
-    
-    vector<double> grad_ne_E1; // \nabla \phi_i^{E_1} \cdot n_e^*
-    grad_ne_E1.push_back( ((E1_y2 - E1_y3) * ne[0] + (E1_x3 - E1_x2) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y3 - E1_y1) * ne[0] + (E1_x1 - E1_x3) * ne[1]) / E1.detBE );
-    grad_ne_E1.push_back( ((E1_y1 - E1_y2) * ne[0] + (E1_x2 - E1_x1) * ne[1]) / E1.detBE );
-    
-    vector<double> grad_ne_E2; // \nabla \phi_i^{E_2} \cdot n_e^*
-    grad_ne_E2.push_back( ((E2_y2 - E2_y3) * ne[0] + (E2_x3 - E2_x2) * ne[1]) / E2.detBE );
-    grad_ne_E2.push_back( ((E2_y3 - E2_y1) * ne[0] + (E2_x1 - E2_x3) * ne[1]) / E2.detBE );
-    grad_ne_E2.push_back( ((E2_y1 - E2_y2) * ne[0] + (E2_x2 - E2_x1) * ne[1]) / E2.detBE );
+    const EdgeGeometry &geo = edgeGeometry[edge.index - 1]; // ne is n_e^* as in the report
+    
+    double grad_ne_E1[3], grad_ne_E2[3]; // \nabla \phi_i^{E_1} \cdot n_e^*
+    grad_ne(E1, geo.ne, grad_ne_E1);
+    grad_ne(E2, geo.ne, grad_ne_E2);
         
     initM(M11, M12, M21, M22, E1.localDof, E2.localDof);
     
@@ -137,13 +117,13 @@ int DGSolvingSystemMPI::edgeIntegMPI(Edge edge, VECMATRIX &M11, VECMATRIX &M12,
     
     if (fst_row <= E1.dofIndex  && E1.dofIndex < fst_row + m_loc)
     {
-        getMii(edge, M11, E1, E1, f_E1, f_E1, eps, ne, grad_ne_E1, grad_ne_E1, -1,  1,  1);
-        getMii(edge, M12, E1, E2, f_E1, f_E2, eps, ne, grad_ne_E1, grad_ne_E2, -1, -1, -1);
+        getMii(M11, E1, E1, geo.f_E1, geo.f_E1, eps, grad_ne_E1, grad_ne_E1, -1,  1,  1);
+        getMii(M12, E1, E2, geo.f_E1, geo.f_E2, eps, grad_ne_E1, grad_ne_E2, -1, -1, -1);
     }
     if (fst_row <= E2.dofIndex  && E2.dofIndex < fst_row + m_loc)
     {
-        getMii(edge, M21, E2, E1, f_E2, f_E1, eps, ne, grad_ne_E2, grad_ne_E1,  1,  1, -1);
-        getMii(edge, M22, E2, E2, f_E2, f_E2, eps, ne, grad_ne_E2, grad_ne_E2,  1, -1,  1);
+        getMii(M21, E2, E1, geo.f_E2, geo.f_E1, eps, grad_ne_E2, grad_ne_E1,  1,  1, -1);
+        getMii(M22, E2, E2, geo.f_E2, geo.f_E2, eps, grad_ne_E2, grad_ne_E2,  1, -1,  1);
     }
     return 0;
 }
@@ -155,7 +135,7 @@ void DGSolvingSystemMPI::assembleStiff()
         cout << "start forming system" << endl;
 #endif
     
-    clock_t t = clock();
+    PhaseTimer dofTimer(Phase::DofNumbering);
     
     // get dof, m_loc, fst_row
     this -> dof = retrieve_dof_count_element_dofIndex(*mesh); // get total dof
@@ -166,18 +146,24 @@ void DGSolvingSystemMPI::assembleStiff()
         if (iam == (grid->nprow * grid->npcol - 1)) /* last proc. gets all*/
             m_loc = dof - m_loc * (grid->nprow * grid->npcol - 1);
     }
+    dofTimer.stop();
+    RunReport::setValue("dof", this -> dof);
 #ifdef __DGSOLVESYS_DEBUG
     if (iam == 0)
         cout << " dof = " << this -> dof << endl;
     // cout << "I am processor " << iam << " m_loc = " << m_loc << " fst_row = " << fst_row << endl;
 #endif
     
+    PhaseTimer elementTimer(Phase::ElementAssembly);
+    
     // initialize rh, ma
     this -> rh = new double [m_loc];
     memset(this -> rh, 0, m_loc * sizeof(double));
     this -> ma.resize(dof);
     
     mesh -> calcDetBE(); //calculate det(B_E) for each element
+    computeGeometry();
+    updateVertexValues();
     
     // assemble element integral related items
     int k = 1;
@@ -190,7 +176,10 @@ void DGSolvingSystemMPI::assembleStiff()
             assembleElementMPI(*it);
         }
     }
-        
+    double t = elementTimer.stop();
+    
+    PhaseTimer edgeTimer(Phase::EdgeAssembly);
+    
     // assemble edge integral related items
     k = 1;
     for (auto it = mesh -> edge.begin(); it != mesh -> edge.end(); ++it, ++k) {
@@ -202,11 +191,11 @@ void DGSolvingSystemMPI::assembleStiff()
     
     
     MPI_Barrier( grid -> comm);
-    t = clock() - t;
+    t += edgeTimer.stop();
 
 #ifdef __DGSOLVESYS_DEBUG
     if (iam == 0)
-        cout << "finish forming system, t = " << (double) t / CLOCKS_PER_SEC << endl << endl;
+        cout << "finish forming system, t = " << t << "s" << endl << endl;
 #endif
 
 }
@@ -214,13 +203,74 @@ void DGSolvingSystemMPI::assembleStiff()
 
 void DGSolvingSystemMPI::output()
 {
-    gatherSolutions();
+    // each processor adds up the errors on the elements of its rows, so x is only gathered for the results
+    bool printError = prob -> parameters.cprintError;
+    double errL2(0), errH1(0);
+    if (printError) {
+        PhaseTimer timer(Phase::ErrorComputation);
+        FormatBuffer residual;
+        double local[2], global[2];
+        errorSquares(x.data(), fst_row, m_loc, local[0], local[1], prob -> parameters.fprintError ? &residual : nullptr);
+        MPI_Allreduce(local, global, 2, MPI_DOUBLE, MPI_SUM, grid -> comm);
+        if (prob -> parameters.fprintError)
+            writeShared(grid -> comm, prob -> parameters.meshFilename + ".err", residual.data(), residual.size());
+        errL2 = sqrt(global[0]);
+        errH1 = sqrt(global[1]);
+        RunReport::setValue("errL2", errL2);
+        RunReport::setValue("errH1", errH1);
+    }
+    
+    if (prob -> parameters.printResults || prob -> parameters.fprintResults)
+        gatherSolutions();
+    
+    // the matrix is written by all processors into one file; text CSC would need it in one
+    // place, so Matrix Market is written instead
+    int fprintMA = prob -> parameters.fprintMA;
+    if (fprintMA && solver != nullptr) {
+        PhaseTimer timer(Phase::Output);
+        if (fprintMA == 3)
+            solver -> writeBinaryCSC(prob -> parameters.meshFilename + ".csc");
+        else
+            solver -> writeMatrixMarket(prob -> parameters.meshFilename + ".mtx");
+    }
     (prob -> parameters).fprintMA = 0;
     (prob -> parameters).fprintRH = 0;
     (prob -> parameters).fprintTriplet = 0;
-    if (iam == 0)
+    (prob -> parameters).cprintError = 0;
+    if (iam == 0) {
         DGSolvingSystem::output();
-    
+        if (printError)
+            cout << "error in L2 norm = " << errL2 << endl
+                 << "error in H1 norm = " << errH1 << endl;
+    }
+    (prob -> parameters).cprintError = printError;
+}
+
+void DGSolvingSystemMPI::report()
+{
+    int world_size;
+    MPI_Comm_size(grid->comm, &world_size);
+
+    vector<double> minTime(constPhaseCount), maxTime(constPhaseCount), avgTime(constPhaseCount);
+    MPI_Reduce(RunReport::times(), minTime.data(), constPhaseCount, MPI_DOUBLE, MPI_MIN, 0, grid->comm);
+    MPI_Reduce(RunReport::times(), maxTime.data(), constPhaseCount, MPI_DOUBLE, MPI_MAX, 0, grid->comm);
+    MPI_Reduce(RunReport::times(), avgTime.data(), constPhaseCount, MPI_DOUBLE, MPI_SUM, 0, grid->comm);
+
+    // nnz is counted by rows in charge, memory by the largest processor
+    double nnz = RunReport::value("nnz"), nnzSum(0);
+    double rss = RunReport::peakRSS(), rssMax(0);
+    MPI_Reduce(&nnz, &nnzSum, 1, MPI_DOUBLE, MPI_SUM, 0, grid->comm);
+    MPI_Reduce(&rss, &rssMax, 1, MPI_DOUBLE, MPI_MAX, 0, grid->comm);
+    RunReport::setValue("nnz", nnzSum);
+    RunReport::setValue("peak_rss_kb", rssMax);
+
+    if (iam == 0 && prob->parameters.fprintReport)
+    {
+        for (double &t : avgTime)
+            t /= world_size;
+        RunReport::writeJSON(prob->parameters.meshFilename + ".report.json", world_size,
+                             minTime.data(), maxTime.data(), avgTime.data());
+    }
 }
 
 void DGSolvingSystemMPI::gatherSolutions()
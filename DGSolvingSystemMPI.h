@@ -39,6 +39,7 @@ public:
     void solveSparse();
     void assembleStiff();
     void output(); 
+    void report(); // reduce phase times over all processors, root writes the report
 };
 
 
@@ -0,0 +1,332 @@
+//
+//  Expression.cpp
+//  tri
+//
+
+#include "Expression.h"
+#include <cmath>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+#include <stdexcept>
+
+using std::string;
+
+const int Expression::BatchSize;
+
+namespace {
+    // a^n by squaring, n integral
+    inline double powInt(double a, int n)
+    {
+        double result = 1, base = n < 0 ? 1 / a : a;
+        for (unsigned k = n < 0 ? -n : n; k; k >>= 1) {
+            if (k & 1)
+                result *= base;
+            base *= base;
+        }
+        return result;
+    }
+
+    template <class F>
+    inline void unaryLoop(double *d, const double *a, int m, F f)
+    {
+        for (int i = 0; i < m; i++)
+            d[i] = f(a[i]);
+    }
+
+    template <class F>
+    inline void binaryLoop(double *d, const double *a, const double *b, int m, F f)
+    {
+        for (int i = 0; i < m; i++)
+            d[i] = f(a[i], b[i]);
+    }
+}
+
+Expression::Expression(const string &text): source(text), numRegisters(0), pos(0), top(0)
+{
+    Operand result = parseSum();
+    skipSpace();
+    if (pos != source.size())
+        error("unexpected \"" + source.substr(pos, 1) + "\"");
+    toRegister(result); // the result ends up in register 0
+    registers.resize(numRegisters * BatchSize);
+}
+
+void Expression::evaluate(const double *x, const double *y, double *value, int n) const
+{
+    for (int start = 0; start < n; start += BatchSize) {
+        int m = std::min(BatchSize, n - start);
+        for (const Instruction &ins : code) {
+            double *d = &registers[ins.dst * BatchSize];
+            const double *a = &registers[ins.a * BatchSize];
+            const double *b = &registers[ins.b * BatchSize];
+            switch (ins.op) {
+                case Op::Const: std::fill(d, d + m, ins.c); break;
+                case Op::X: std::copy(x + start, x + start + m, d); break;
+                case Op::Y: std::copy(y + start, y + start + m, d); break;
+                case Op::Add: binaryLoop(d, a, b, m, [](double u, double v) { return u + v; }); break;
+                case Op::Sub: binaryLoop(d, a, b, m, [](double u, double v) { return u - v; }); break;
+                case Op::Mul: binaryLoop(d, a, b, m, [](double u, double v) { return u * v; }); break;
+                case Op::Div: binaryLoop(d, a, b, m, [](double u, double v) { return u / v; }); break;
+                case Op::Pow: binaryLoop(d, a, b, m, [](double u, double v) { return std::pow(u, v); }); break;
+                case Op::Min: binaryLoop(d, a, b, m, [](double u, double v) { return std::min(u, v); }); break;
+                case Op::Max: binaryLoop(d, a, b, m, [](double u, double v) { return std::max(u, v); }); break;
+                case Op::Neg: unaryLoop(d, a, m, [](double u) { return -u; }); break;
+                case Op::PowInt:
+                    if (ins.c == 2)
+                        unaryLoop(d, a, m, [](double u) { return u * u; });
+                    else {
+                        int k = (int) ins.c;
+                        unaryLoop(d, a, m, [k](double u) { return powInt(u, k); });
+                    }
+                    break;
+                case Op::Sin: unaryLoop(d, a, m, [](double u) { return std::sin(u); }); break;
+                case Op::Cos: unaryLoop(d, a, m, [](double u) { return std::cos(u); }); break;
+                case Op::Tan: unaryLoop(d, a, m, [](double u) { return std::tan(u); }); break;
+                case Op::Asin: unaryLoop(d, a, m, [](double u) { return std::asin(u); }); break;
+                case Op::Acos: unaryLoop(d, a, m, [](double u) { return std::acos(u); }); break;
+                case Op::Atan: unaryLoop(d, a, m, [](double u) { return std::atan(u); }); break;
+                case Op::Sinh: unaryLoop(d, a, m, [](double u) { return std::sinh(u); }); break;
+                case Op::Cosh: unaryLoop(d, a, m, [](double u) { return std::cosh(u); }); break;
+                case Op::Tanh: unaryLoop(d, a, m, [](double u) { return std::tanh(u); }); break;
+                case Op::Exp: unaryLoop(d, a, m, [](double u) { return std::exp(u); }); break;
+                case Op::Log: unaryLoop(d, a, m, [](double u) { return std::log(u); }); break;
+                case Op::Sqrt: unaryLoop(d, a, m, [](double u) { return std::sqrt(u); }); break;
+                case Op::Abs: unaryLoop(d, a, m, [](double u) { return std::fabs(u); }); break;
+            }
+        }
+        std::copy(registers.begin(), registers.begin() + m, value + start);
+    }
+}
+
+double Expression::evaluate(double x, double y) const
+{
+    double value;
+    evaluate(&x, &y, &value, 1);
+    return value;
+}
+
+// the same operations on constants, for folding
+double Expression::apply(Op op, double a, double b, double c)
+{
+    switch (op) {
+        case Op::Add: return a + b;
+        case Op::Sub: return a - b;
+        case Op::Mul: return a * b;
+        case Op::Div: return a / b;
+        case Op::Pow: return std::pow(a, b);
+        case Op::Min: return std::min(a, b);
+        case Op::Max: return std::max(a, b);
+        case Op::Neg: return -a;
+        case Op::PowInt: return powInt(a, (int) c);
+        case Op::Sin: return std::sin(a);
+        case Op::Cos: return std::cos(a);
+        case Op::Tan: return std::tan(a);
+        case Op::Asin: return std::asin(a);
+        case Op::Acos: return std::acos(a);
+        case Op::Atan: return std::atan(a);
+        case Op::Sinh: return std::sinh(a);
+        case Op::Cosh: return std::cosh(a);
+        case Op::Tanh: return std::tanh(a);
+        case Op::Exp: return std::exp(a);
+        case Op::Log: return std::log(a);
+        case Op::Sqrt: return std::sqrt(a);
+        case Op::Abs: return std::fabs(a);
+        default: return c;
+    }
+}
+
+void Expression::error(const string &what) const
+{
+    throw std::runtime_error("expression \"" + source + "\": " + what + " at position " + std::to_string(pos + 1));
+}
+
+void Expression::skipSpace()
+{
+    while (pos < source.size() && isspace((unsigned char) source[pos]))
+        pos++;
+}
+
+bool Expression::accept(char ch)
+{
+    skipSpace();
+    if (pos < source.size() && source[pos] == ch) {
+        pos++;
+        return true;
+    }
+    return false;
+}
+
+void Expression::expect(char ch)
+{
+    if (!accept(ch))
+        error(string("expected \"") + ch + "\"");
+}
+
+int Expression::allocate()
+{
+    numRegisters = std::max(numRegisters, top + 1);
+    return top++;
+}
+
+int Expression::toRegister(Operand &operand)
+{
+    if (operand.isConst) {
+        Instruction ins = {Op::Const, allocate(), 0, 0, operand.value};
+        code.push_back(ins);
+        operand.isConst = false;
+        operand.reg = ins.dst;
+    }
+    return operand.reg;
+}
+
+// operands sit on top of the register stack, so the result takes the lowest of their registers
+Expression::Operand Expression::emitUnary(Op op, Operand a, double c)
+{
+    if (a.isConst) {
+        a.value = apply(op, a.value, 0, c);
+        return a;
+    }
+    Instruction ins = {op, a.reg, a.reg, 0, c};
+    code.push_back(ins);
+    return a;
+}
+
+Expression::Operand Expression::emitBinary(Op op, Operand a, Operand b)
+{
+    if (a.isConst && b.isConst) {
+        a.value = apply(op, a.value, b.value, 0);
+        return a;
+    }
+    int ra = toRegister(a), rb = toRegister(b);
+    Instruction ins = {op, std::min(ra, rb), ra, rb, 0};
+    code.push_back(ins);
+    top = ins.dst + 1;
+    Operand result = {false, 0, ins.dst};
+    return result;
+}
+
+// sum := product (('+' | '-') product)*
+Expression::Operand Expression::parseSum()
+{
+    Operand result = parseProduct();
+    while (true) {
+        if (accept('+'))
+            result = emitBinary(Op::Add, result, parseProduct());
+        else if (accept('-'))
+            result = emitBinary(Op::Sub, result, parseProduct());
+        else
+            return result;
+    }
+}
+
+// product := unary (('*' | '/') unary)*
+Expression::Operand Expression::parseProduct()
+{
+    Operand result = parseUnary();
+    while (true) {
+        if (accept('*'))
+            result = emitBinary(Op::Mul, result, parseUnary());
+        else if (accept('/'))
+            result = emitBinary(Op::Div, result, parseUnary());
+        else
+            return result;
+    }
+}
+
+// unary := ('-' | '+') unary | power, so -x^2 = -(x^2)
+Expression::Operand Expression::parseUnary()
+{
+    if (accept('-'))
+        return emitUnary(Op::Neg, parseUnary());
+    if (accept('+'))
+        return parseUnary();
+    return parsePower();
+}
+
+// power := primary ('^' unary)?, right associative
+Expression::Operand Expression::parsePower()
+{
+    Operand base = parsePrimary();
+    if (!accept('^'))
+        return base;
+    Operand exponent = parseUnary();
+    if (exponent.isConst && exponent.value == std::floor(exponent.value) && std::fabs(exponent.value) <= 64)
+        return emitUnary(Op::PowInt, base, exponent.value);
+    return emitBinary(Op::Pow, base, exponent);
+}
+
+// primary := number | x | y | pi | name '(' arguments ')' | '(' sum ')'
+Expression::Operand Expression::parsePrimary()
+{
+    skipSpace();
+    if (pos == source.size())
+        error("unexpected end");
+
+    if (accept('(')) {
+        Operand result = parseSum();
+        expect(')');
+        return result;
+    }
+
+    const char *start = source.c_str() + pos;
+    if (isdigit((unsigned char) *start) || *start == '.') {
+        char *end;
+        Operand result = {true, strtod(start, &end), 0};
+        if (end == start)
+            error("bad number");
+        pos += end - start;
+        return result;
+    }
+
+    if (!isalpha((unsigned char) *start))
+        error("unexpected \"" + source.substr(pos, 1) + "\"");
+    size_t first = pos;
+    while (pos < source.size() && (isalnum((unsigned char) source[pos]) || source[pos] == '_'))
+        pos++;
+    string name = source.substr(first, pos - first);
+
+    if (name == "pi") {
+        Operand result = {true, std::acos(-1.0), 0};
+        return result;
+    }
+    if (name == "x" || name == "y") {
+        Instruction ins = {name == "x" ? Op::X : Op::Y, allocate(), 0, 0, 0};
+        code.push_back(ins);
+        Operand result = {false, 0, ins.dst};
+        return result;
+    }
+    if (!accept('('))
+        error("unknown variable " + name);
+    Operand result = parseCall(name);
+    expect(')');
+    return result;
+}
+
+Expression::Operand Expression::parseCall(const string &name)
+{
+    static const struct { const char *name; Op op; } unary[] = {
+        {"sin", Op::Sin}, {"cos", Op::Cos}, {"tan", Op::Tan}, {"asin", Op::Asin}, {"acos", Op::Acos},
+        {"atan", Op::Atan}, {"sinh", Op::Sinh}, {"cosh", Op::Cosh}, {"tanh", Op::Tanh},
+        {"exp", Op::Exp}, {"log", Op::Log}, {"sqrt", Op::Sqrt}, {"abs", Op::Abs}
+    };
+    for (auto &fn : unary)
+        if (name == fn.name)
+            return emitUnary(fn.op, parseSum());
+
+    Op op;
+    if (name == "pow")
+        op = Op::Pow;
+    else if (name == "min")
+        op = Op::Min;
+    else if (name == "max")
+        op = Op::Max;
+    else
+        error("unknown function " + name);
+    Operand a = parseSum();
+    expect(',');
+    Operand b = parseSum();
+    if (op == Op::Pow && b.isConst && b.value == std::floor(b.value) && std::fabs(b.value) <= 64)
+        return emitUnary(Op::PowInt, a, b.value);
+    return emitBinary(op, a, b);
+}
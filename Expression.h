@@ -0,0 +1,73 @@
+//
+//  Expression.h
+//  tri
+//
+//  An expression in x and y such as "2 * cos(x) * sin(y)", compiled at
+// startup into register bytecode. Each instruction runs over a batch of
+// points before the next one is dispatched, so the interpreter cost is
+// paid once per batch rather than once per point. Numbers, x, y, pi,
+// + - * / ^, parentheses and sin cos tan asin acos atan sinh cosh tanh
+// exp log sqrt abs pow min max are understood; constant parts are folded.
+
+#ifndef __tri__Expression__
+#define __tri__Expression__
+
+#include <string>
+#include <vector>
+
+class Expression {
+public:
+    Expression(const std::string &text); // throws std::runtime_error on a syntax error
+
+    const std::string &text() const { return source; }
+
+    // value[i] = expression at (x[i], y[i]) for i < n
+    void evaluate(const double *x, const double *y, double *value, int n) const;
+    double evaluate(double x, double y) const;
+
+private:
+    enum class Op {
+        Const, X, Y, Add, Sub, Mul, Div, Neg, PowInt, Pow, Min, Max,
+        Sin, Cos, Tan, Asin, Acos, Atan, Sinh, Cosh, Tanh, Exp, Log, Sqrt, Abs
+    };
+    struct Instruction {
+        Op op;
+        int dst, a, b;  // registers
+        double c;       // constant of Const, exponent of PowInt
+    };
+    // a parsed subexpression, either a constant not yet in a register or a register
+    struct Operand {
+        bool isConst;
+        double value;
+        int reg;
+    };
+
+    static const int BatchSize = 256;
+
+    std::string source;
+    std::vector<Instruction> code;
+    int numRegisters;
+    mutable std::vector<double> registers; // numRegisters x BatchSize
+
+    // recursive descent parser emitting code, registers are used as a stack
+    size_t pos;
+    int top;
+    void skipSpace();
+    bool accept(char ch);
+    void expect(char ch);
+    [[noreturn]] void error(const std::string &what) const;
+    Operand parseSum();
+    Operand parseProduct();
+    Operand parseUnary();
+    Operand parsePower();
+    Operand parsePrimary();
+    Operand parseCall(const std::string &name);
+
+    int allocate();
+    int toRegister(Operand &operand);
+    Operand emitUnary(Op op, Operand a, double c = 0);
+    Operand emitBinary(Op op, Operand a, Operand b);
+    static double apply(Op op, double a, double b, double c);
+};
+
+#endif /* defined(__tri__Expression__) */
@@ -0,0 +1,79 @@
+//
+//  FormatBuffer.h
+//  tri
+//
+//  Numbers formatted into a character buffer that is written to its
+// stream in blocks of about 1 MB, or kept in memory without a stream.
+// Integers are formatted by hand, doubles by snprintf with %g and the
+// given precision, which prints them as the default ostream does.
+
+#ifndef __tri__FormatBuffer__
+#define __tri__FormatBuffer__
+
+#include <ostream>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+
+class FormatBuffer {
+    std::ostream *sink;
+    std::vector<char> text;
+    int precision;
+
+    static const size_t BlockSize = 1 << 20;
+
+    void append(const char *s, size_t n)
+    {
+        text.insert(text.end(), s, s + n);
+        if (sink && text.size() >= BlockSize)
+            flush();
+    }
+
+public:
+    // precision 17 keeps doubles exact
+    explicit FormatBuffer(std::ostream *out = nullptr, int digits = 6): sink(out), precision(digits)
+    {
+        text.reserve(sink ? BlockSize + 64 : 0);
+    }
+    ~FormatBuffer() { flush(); }
+
+    FormatBuffer &operator<<(char c) { append(&c, 1); return *this; }
+    FormatBuffer &operator<<(const char *s) { append(s, strlen(s)); return *this; }
+    FormatBuffer &operator<<(int v) { return *this << (long long) v; }
+    FormatBuffer &operator<<(long long v)
+    {
+        char digits[24];
+        int n = sizeof(digits);
+        unsigned long long u = v < 0 ? 0ULL - (unsigned long long) v : (unsigned long long) v;
+        do {
+            digits[--n] = '0' + u % 10;
+            u /= 10;
+        } while (u);
+        if (v < 0)
+            digits[--n] = '-';
+        append(digits + n, sizeof(digits) - n);
+        return *this;
+    }
+    FormatBuffer &operator<<(double v)
+    {
+        char digits[32];
+        int n = snprintf(digits, sizeof(digits), "%.*g", precision, v);
+        append(digits, n);
+        return *this;
+    }
+
+    // write the buffered text to the stream, if any
+    void flush()
+    {
+        if (!sink || text.empty())
+            return;
+        sink -> write(text.data(), text.size());
+        text.clear();
+    }
+
+    // the text kept without a stream
+    const char *data() const { return text.data(); }
+    size_t size() const { return text.size(); }
+};
+
+#endif /* defined(__tri__FormatBuffer__) */
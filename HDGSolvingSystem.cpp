@@ -0,0 +1,285 @@
+//
+//  HDGSolvingSystem.cpp
+//  tri
+//
+
+#include "HDGSolvingSystem.h"
+#include "Parallel.h"
+#include <algorithm>
+
+using std::vector;
+using std::cout;
+using std::endl;
+
+namespace {
+    // the elements go through condensation and recovery in chunks of this size
+    const int Chunk = 8192;
+
+    // solve A X = B for the 3 x m matrix B, row major, in place by Gaussian elimination with partial pivoting
+    void solveLocal(const double A[3][3], double *B, int m)
+    {
+        double a[3][3];
+        memcpy(a, A, sizeof(a));
+        for (int k = 0; k < 3; k++) {
+            int p = k;
+            for (int i = k + 1; i < 3; i++)
+                if (fabs(a[i][k]) > fabs(a[p][k]))
+                    p = i;
+            if (a[p][k] == 0)
+                throw std::runtime_error("singular element matrix in hybridized DG");
+            if (p != k) {
+                std::swap_ranges(a[k], a[k] + 3, a[p]);
+                std::swap_ranges(B + k * m, B + (k + 1) * m, B + p * m);
+            }
+            for (int i = k + 1; i < 3; i++) {
+                double l = a[i][k] / a[k][k];
+                for (int j = k; j < 3; j++)
+                    a[i][j] -= l * a[k][j];
+                for (int j = 0; j < m; j++)
+                    B[i * m + j] -= l * B[k * m + j];
+            }
+        }
+        for (int k = 2; k >= 0; k--) {
+            for (int i = k + 1; i < 3; i++)
+                for (int j = 0; j < m; j++)
+                    B[k * m + j] -= a[k][i] * B[i * m + j];
+            for (int j = 0; j < m; j++)
+                B[k * m + j] /= a[k][k];
+        }
+    }
+}
+
+void HDGSolvingSystem::numberTraces()
+{
+    elementDof = retrieve_dof_count_element_dofIndex(*mesh);
+
+    elementFaces.assign(mesh -> element.size(), vector<int>());
+    traceIndex.assign(mesh -> edge.size(), -1);
+    dof = 0;
+    for (Edge &ed : mesh -> edge) {
+        if (ed.reftype != constNonrefined)
+            continue;
+        for (int iEle : ed.neighborElement)
+            elementFaces[iEle - 1].push_back(ed.index);
+        if (ed.neighborElement.size() == 2) {
+            traceIndex[ed.index - 1] = dof;
+            dof += 2;
+        }
+    }
+}
+
+// the face terms with the trace table t of the face, t[i][k] the basis function of vertex i at vertex k
+// of the edge, and gl[i] = |e| grad phi_i . n, n pointing out of ele
+void HDGSolvingSystem::localSystem(const Element &ele, HDGLocalSystem &local)
+{
+    const vector<int> &faces = elementFaces[ele.index - 1];
+    const int m = 2 * (int) faces.size();
+    local.nTrace = m;
+    local.Aul.assign(3 * m, 0);
+    local.Alu.assign(m * 3, 0);
+    local.All.assign(m * m, 0);
+
+    VECMATRIX stiff = elementInteg(ele);
+    vector<double> load = elementIntegRhs(ele);
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 3; j++)
+            local.Auu[i][j] = stiff[i][j];
+        local.bu[i] = load[i];
+    }
+
+    const double eps = prob -> epsilon;
+    const ElementGeometry &geo = elementGeometry[ele.index - 1];
+    for (int f = 0; f < (int) faces.size(); f++) {
+        const Edge &ed = mesh -> edge[faces[f] - 1];
+        double t[3][2], ne[2], gl[3];
+        interiorNormal(ed, ele, hangingTrace(ed, ele, t), ne); // ne = |e| / 4 n
+        for (int i = 0; i < 3; i++)
+            gl[i] = 4 * (geo.grad[i][0] * ne[0] + geo.grad[i][1] * ne[1]) / geo.det;
+
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                local.Auu[i][j] += -gl[j] * (t[i][0] + t[i][1]) / 2 + eps * gl[i] * (t[j][0] + t[j][1]) / 2
+                                 + penaltyOver6 * penaltyTerm(i, j, t, t);
+        for (int k = 0; k < 2; k++) {
+            int c = 2 * f + k;
+            for (int i = 0; i < 3; i++) {
+                local.Aul[i * m + c] = -eps * gl[i] / 2 - penaltyOver6 * (2 * t[i][k] + t[i][1 - k]);
+                local.Alu[c * 3 + i] = gl[i] / 2 - penaltyOver6 * (2 * t[i][k] + t[i][1 - k]);
+            }
+            local.All[c * m + 2 * f] = penaltyOver6 * (k == 0 ? 2 : 1);
+            local.All[c * m + 2 * f + 1] = penaltyOver6 * (k == 1 ? 2 : 1);
+        }
+    }
+}
+
+void HDGSolvingSystem::traceValues(const Element &ele, const double *traces, double *lambda)
+{
+    const vector<int> &faces = elementFaces[ele.index - 1];
+    for (int f = 0; f < (int) faces.size(); f++) {
+        const Edge &ed = mesh -> edge[faces[f] - 1];
+        int first = traceIndex[ed.index - 1];
+        for (int k = 0; k < 2; k++)
+            lambda[2 * f + k] = first < 0 ? gdVertex[ed.vertex[k] - 1] : traces ? traces[first + k] : 0;
+    }
+}
+
+// S = All - Alu Auu^-1 Aul and g = -Alu Auu^-1 bu of each element in parallel, added to ma and rh
+// in element order; the columns of boundary faces go to the right-hand side with the values of g_D
+void HDGSolvingSystem::condense()
+{
+    vector<int> leaves;
+    for (const Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            leaves.push_back(ele.index);
+
+    vector< vector<double> > S, g;
+    for (vector<int>::size_type first = 0; first < leaves.size(); first += Chunk) {
+        const int *chunkLeaves = leaves.data() + first;
+        int n = std::min<vector<int>::size_type>(Chunk, leaves.size() - first);
+        S.resize(n);
+        g.resize(n);
+
+        PhaseTimer elementTimer(Phase::ElementAssembly);
+        parallelFor(n, [&](int k) {
+            const Element &ele = mesh -> element[chunkLeaves[k] - 1];
+            HDGLocalSystem local;
+            localSystem(ele, local);
+            const int m = local.nTrace;
+            vector<double> X(3 * (m + 1)); // [Aul bu], then Auu^-1 [Aul bu]
+            for (int i = 0; i < 3; i++) {
+                std::copy(&local.Aul[i * m], &local.Aul[i * m] + m, &X[i * (m + 1)]);
+                X[i * (m + 1) + m] = local.bu[i];
+            }
+            solveLocal(local.Auu, X.data(), m + 1);
+
+            S[k].assign(local.All.begin(), local.All.end());
+            g[k].assign(m, 0);
+            for (int r = 0; r < m; r++)
+                for (int i = 0; i < 3; i++) {
+                    for (int c = 0; c < m; c++)
+                        S[k][r * m + c] -= local.Alu[r * 3 + i] * X[i * (m + 1) + c];
+                    g[k][r] -= local.Alu[r * 3 + i] * X[i * (m + 1) + m];
+                }
+        });
+        elementTimer.stop();
+
+        PhaseTimer edgeTimer(Phase::EdgeAssembly);
+        vector<double> lambda;
+        for (int k = 0; k < n; k++) {
+            const Element &ele = mesh -> element[chunkLeaves[k] - 1];
+            const vector<int> &faces = elementFaces[ele.index - 1];
+            const int m = 2 * (int) faces.size();
+            lambda.resize(m);
+            traceValues(ele, nullptr, lambda.data());
+            for (int r = 0; r < m; r++) {
+                int row = traceIndex[faces[r / 2] - 1];
+                if (row < 0)
+                    continue;
+                row += r % 2;
+                double value = g[k][r];
+                for (int c = 0; c < m; c++) {
+                    int col = traceIndex[faces[c / 2] - 1];
+                    if (col < 0)
+                        value -= S[k][r * m + c] * lambda[c];
+                    else
+                        addToMA(S[k][r * m + c], row, col + c % 2);
+                }
+                rh[row] += value;
+            }
+        }
+    }
+}
+
+void HDGSolvingSystem::recover()
+{
+    PhaseTimer timer(Phase::Solve);
+    x.assign(elementDof, 0);
+    vector<int> leaves;
+    for (const Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            leaves.push_back(ele.index);
+
+    // u = Auu^-1 (bu - Aul lambda)
+    parallelFor((int) leaves.size(), [&](int k) {
+        const Element &ele = mesh -> element[leaves[k] - 1];
+        HDGLocalSystem local;
+        localSystem(ele, local);
+        const int m = local.nTrace;
+        vector<double> lambda(m);
+        traceValues(ele, trace.data(), lambda.data());
+        double u[3];
+        for (int i = 0; i < 3; i++) {
+            u[i] = local.bu[i];
+            for (int c = 0; c < m; c++)
+                u[i] -= local.Aul[i * m + c] * lambda[c];
+        }
+        solveLocal(local.Auu, u, 1);
+        for (int i = 0; i < 3; i++)
+            x[ele.dofIndex + i] = u[i];
+    });
+}
+
+void HDGSolvingSystem::assembleStiff()
+{
+    if (prob -> sigma0 <= 0)
+        throw std::runtime_error("hybridized DG needs sigma0 > 0");
+    updateVertexValues();
+
+#ifdef __DGSOLVESYS_DEBUG
+    cout << "start forming hybridized system" << endl;
+#endif
+
+    PhaseTimer dofTimer(Phase::DofNumbering);
+    numberTraces();
+    dofTimer.stop();
+    RunReport::setValue("dof", dof);
+    RunReport::setValue("element_dof", elementDof);
+#ifdef __DGSOLVESYS_DEBUG
+    cout << " dof = " << dof << " on the edges, " << elementDof << " on the elements eliminated" << endl;
+#endif
+
+    delete[] rh;
+    rh = new double [dof];
+    memset(rh, 0, dof * sizeof(double));
+    beginStaging();
+    ma.clear();
+    if (staging == nullptr)
+        ma.resize(dof);
+
+    mesh -> calcDetBE();
+    vector<int> leaves;
+    for (const Element &ele : mesh -> element)
+        if (ele.reftype == constNonrefined)
+            leaves.push_back(ele.index);
+    computeGeometry(leaves, vector<int>()); // the faces take their traces and normals in localSystem
+
+    condense();
+
+#ifdef __DGSOLVESYS_DEBUG
+    cout << "finish forming hybridized system" << endl << endl;
+#endif
+}
+
+// the entries of ma stay in place with their values reset, as in DGSolvingSystem
+void HDGSolvingSystem::reassembleValues()
+{
+    if (prob -> sigma0 <= 0)
+        throw std::runtime_error("hybridized DG needs sigma0 > 0");
+    penaltyOver6 = prob -> sigma0 / 6.0;
+    beginStaging();
+    for (auto &col : ma)
+        for (maColEle &entry : col)
+            entry.value = 0;
+    memset(rh, 0, dof * sizeof(double));
+    condense();
+}
+
+void HDGSolvingSystem::solveSparse()
+{
+    if (dof > 0)
+        BasicSolvingSystem::solveSparse();
+    else
+        x.clear(); // all edges on the boundary
+    trace.swap(x);
+    recover();
+}
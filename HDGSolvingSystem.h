@@ -0,0 +1,50 @@
+//
+//  HDGSolvingSystem.h
+//  tri
+//
+//  Hybridized DG: the global unknowns are linear traces on the leaf
+// edges, two per interior edge, and the linear unknowns of each element
+// are eliminated element by element in parallel before the solve and
+// recovered from the traces after it. For each element E with faces e
+//   (grad u, grad v)_E - <grad u . n, v - mu>_e + epsilon <grad v . n, u - lambda>_e
+//   + sigma0 / |e| <u - lambda, v - mu>_e = (f, v)_E
+// with lambda = g_D on boundary edges, so epsilon and sigma0 play the
+// roles they play in DGSolvingSystem. An element with hanging nodes has
+// a face for each leaf edge on its sides.
+
+#ifndef __tri__HDGSolvingSystem__
+#define __tri__HDGSolvingSystem__
+
+#include "DGSolvingSystem.h"
+
+// the element matrix before condensation, u the element unknowns and l the traces on its faces,
+// two per face at the vertices of the edge; row major
+struct HDGLocalSystem {
+    int nTrace;
+    double Auu[3][3];
+    double bu[3];
+    std::vector<double> Aul, Alu, All; // 3 x nTrace, nTrace x 3, nTrace x nTrace
+};
+
+class HDGSolvingSystem: public DGSolvingSystem {
+    int elementDof; // unknowns of the leaf elements, numbered by dofIndex as in DGSolvingSystem
+    std::vector< std::vector<int> > elementFaces; // leaf edges on the sides of each leaf element, by index - 1
+    std::vector<int> traceIndex; // first global unknown of each leaf interior edge, -1 on the boundary, by index - 1
+    std::vector<double> trace;   // the traces of the last solve
+
+    void numberTraces(); // number the elements and the interior edges and find the faces of each element
+    void localSystem(const Element &ele, HDGLocalSystem &local);
+    void traceValues(const Element &ele, const double *traces, double *lambda); // g_D on boundary faces, 0 on the others without traces
+    void condense(); // eliminate the element unknowns and add the trace system to ma and rh
+    void recover();  // the element unknowns from the traces, into x
+
+public:
+    HDGSolvingSystem(Mesh* m, Problem* p): DGSolvingSystem(m, p), elementDof(0) {}
+    void assembleStiff(); // the whole trace system, also after refinement
+    void reassembleValues();
+    void solveSparse();   // solve for the traces and recover the element unknowns
+    void solveTransient() { throw std::runtime_error("time stepping is not supported by hybridized DG"); }
+    void solveNonlinear() { throw std::runtime_error("problems with a reaction term are not supported by hybridized DG"); }
+};
+
+#endif /* defined(__tri__HDGSolvingSystem__) */
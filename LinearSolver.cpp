@@ -7,12 +7,33 @@
 //
 
 #include "LinearSolver.h"
+#include "FormatBuffer.h"
+#include "OutOfCoreMatrix.h"
+#include <fstream>
+#include <cstdint>
+#include <stdexcept>
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SolverStatistics::SolverStatistics():
+    nnz(0), symbolicFactorizations(0), numericFactorizations(0), solves(0),
+    symbolicSeconds(0), numericSeconds(0), solveSeconds(0), factorNonzeros(-1), factorFlops(-1), solveFlops(-1),
+    peakMB(-1), rcond(-1), pivotGrowth(-1), backwardError(-1)
+{
+}
 
 // convert the list-stored matrix to CSC
 LinearSolver::LinearSolver(std::vector< std::list<maColEle> > &ma,
                            int femDof, double *femRH):
-    dof(femDof), rh(femRH)
+    dof(femDof), rh(femRH), mapped(nullptr), mappedSize(0), keepFactors(false), printStats(false)
 {
+    PhaseTimer timer(Phase::CSCConversion);
     std::cout << "start converting to CSC structure" << std::endl;
     //sort entries in each column by their row
     std::vector< std::list<maColEle> >::iterator it;
@@ -38,5 +59,248 @@ LinearSolver::LinearSolver(std::vector< std::list<maColEle> > &ma,
             Ai[k] = it1 -> row;
             Ax[k] = it1 -> value;
         }
+    stats.nnz = nnz;
+    RunReport::setValue("nnz", nnz);
     std::cout << "finish converting to CSC structure" << std::endl << std::endl;
-}
\ No newline at end of file
+}
+
+// private and writable so that a solver writing to the arrays does not change the file
+LinearSolver::LinearSolver(const std::string &stagedFile, int femDof, double *femRH):
+    dof(femDof), rh(femRH), mapped(nullptr), mappedSize(0), keepFactors(false), printStats(false)
+{
+    PhaseTimer timer(Phase::CSCConversion);
+    int fd = open(stagedFile.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        throw std::runtime_error("error opening " + stagedFile);
+    void *p = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+        throw std::runtime_error("error mapping " + stagedFile);
+    mapped = p;
+    mappedSize = st.st_size;
+    
+    const char *base = static_cast<const char *>(mapped);
+    int64_t size[2];
+    memcpy(size, base + 8, sizeof(size));
+    long long valueOffset = OutOfCoreMatrix::valueOffset(dof);
+    if (mappedSize < 24 || memcmp(base, "TRIOOC1\n", 8) != 0 || size[0] != dof
+        || (long long) mappedSize != valueOffset + size[1] * (long long) (sizeof(double) + sizeof(int)))
+        throw std::runtime_error(stagedFile + " is not a staged matrix of " + std::to_string(dof) + " dof");
+    Ap = (int *) (base + 8 + sizeof(size));
+    Ax = (double *) (base + valueOffset);
+    Ai = (int *) (base + valueOffset + size[1] * sizeof(double));
+    stats.nnz = size[1];
+    RunReport::setValue("nnz", size[1]);
+}
+
+LinearSolver::~LinearSolver()
+{
+    if (mapped != nullptr) {
+        munmap(mapped, mappedSize);
+        return;
+    }
+    delete [] Ap;
+    delete [] Ai;
+    delete [] Ax;
+}
+
+std::vector<double> LinearSolver::solve(const std::vector<double> &b)
+{
+    throw std::runtime_error("this solver cannot keep its factorization for later solves");
+}
+
+bool LinearSolver::updateValues(std::vector< std::list<maColEle> > &ma,
+                                int femDof, double *femRH)
+{
+    if (mapped != nullptr || femDof != dof || (int) ma.size() != dof)
+        return false;
+    
+    PhaseTimer timer(Phase::CSCConversion);
+    int k(0);
+    for (int col = 0; col < dof; col++) {
+        if ((int) ma[col].size() != Ap[col + 1] - Ap[col])
+            return false;
+        ma[col].sort([](const maColEle t1, const maColEle t2) {return t1.row < t2.row;});
+        for (std::list<maColEle>::iterator it = ma[col].begin(); it != ma[col].end(); it++, k++) {
+            if (it -> row != Ai[k])
+                return false;
+            Ax[k] = it -> value;
+        }
+    }
+    rh = femRH;
+    return true;
+}
+
+std::vector<long long> LinearSolver::rowHistogram(const std::vector<int> &rowNonzeros)
+{
+    std::vector<long long> histogram(1, 0);
+    for (int count : rowNonzeros) {
+        int bucket = 0;
+        while (count >> bucket)
+            bucket++;
+        if (bucket >= (int) histogram.size())
+            histogram.resize(bucket + 1, 0);
+        histogram[bucket]++;
+    }
+    return histogram;
+}
+
+double LinearSolver::backwardError(const double *b, const std::vector<double> &x) const
+{
+    if ((int) x.size() != dof)
+        return -1;
+    std::vector<double> r(b, b + dof), scale(dof);
+    for (int i = 0; i < dof; i++)
+        scale[i] = std::fabs(b[i]);
+    for (int col = 0; col < dof; col++)
+        for (int k = Ap[col]; k < Ap[col + 1]; k++) {
+            r[Ai[k]] -= Ax[k] * x[col];
+            scale[Ai[k]] += std::fabs(Ax[k] * x[col]);
+        }
+    double berr = 0;
+    for (int i = 0; i < dof; i++)
+        if (scale[i] > 0)
+            berr = std::max(berr, std::fabs(r[i]) / scale[i]);
+    return berr;
+}
+
+void LinearSolver::finishSolve(const double *b, const std::vector<double> &x, bool print)
+{
+    stats.solves++;
+    stats.backwardError = backwardError(b, x);
+    reportStatistics(print);
+}
+
+void LinearSolver::reportStatistics(bool toConsole)
+{
+    if (stats.rowHistogram.empty()) {
+        std::vector<int> rowNonzeros(dof, 0);
+        for (int k = 0; k < Ap[dof]; k++)
+            rowNonzeros[Ai[k]]++;
+        stats.rowHistogram = rowHistogram(rowNonzeros);
+    }
+    RunReport::setValue("nnz", stats.nnz);
+    for (std::vector<long long>::size_type k = 0; k < stats.rowHistogram.size(); k++)
+        if (stats.rowHistogram[k] > 0) {
+            long long low = k ? 1LL << (k - 1) : 0, high = k ? (1LL << k) - 1 : 0;
+            RunReport::setValue("row_nnz_" + std::to_string(low) + (high > low ? "_" + std::to_string(high) : ""),
+                                stats.rowHistogram[k]);
+        }
+    RunReport::setValue("symbolic_factorizations", stats.symbolicFactorizations);
+    RunReport::setValue("numeric_factorizations", stats.numericFactorizations);
+    RunReport::setValue("solves", stats.solves);
+    RunReport::setValue("solver_symbolic_time", stats.symbolicSeconds);
+    RunReport::setValue("solver_numeric_time", stats.numericSeconds);
+    RunReport::setValue("solver_solve_time", stats.solveSeconds);
+    const std::pair<const char *, double> optional[] = {
+        {"factor_nnz", stats.factorNonzeros}, {"factor_flops", stats.factorFlops}, {"solve_flops", stats.solveFlops},
+        {"solver_peak_mb", stats.peakMB}, {"rcond", stats.rcond}, {"reciprocal_pivot_growth", stats.pivotGrowth},
+        {"backward_error", stats.backwardError}
+    };
+    for (const auto &value : optional)
+        if (value.second >= 0)
+            RunReport::setValue(value.first, value.second);
+    
+    if (!toConsole)
+        return;
+    std::cout << "solver statistics:" << std::endl
+              << "  nnz " << stats.nnz << ", rows by nnz";
+    for (std::vector<long long>::size_type k = 0; k < stats.rowHistogram.size(); k++)
+        if (stats.rowHistogram[k] > 0) {
+            long long low = k ? 1LL << (k - 1) : 0, high = k ? (1LL << k) - 1 : 0;
+            std::cout << " " << low;
+            if (high > low)
+                std::cout << "-" << high;
+            std::cout << ": " << stats.rowHistogram[k];
+        }
+    std::cout << std::endl
+              << "  " << stats.symbolicFactorizations << " symbolic factorizations " << stats.symbolicSeconds << "s, "
+              << stats.numericFactorizations << " numeric " << stats.numericSeconds << "s, "
+              << stats.solves << " solves " << stats.solveSeconds << "s" << std::endl;
+    for (const auto &value : optional)
+        if (value.second >= 0)
+            std::cout << "  " << value.first << " " << value.second << std::endl;
+}
+
+namespace {
+    // 64-bit FNV-1a
+    void hashBytes(unsigned long long &hash, const void *data, size_t n)
+    {
+        const unsigned char *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < n; i++) {
+            hash ^= p[i];
+            hash *= 1099511628211ULL;
+        }
+    }
+}
+
+std::string LinearSolver::factorFile(const std::string &name) const
+{
+    if (factorDir.empty())
+        return "";
+    unsigned long long hash = 14695981039346656037ULL;
+    hashBytes(hash, &dof, sizeof(dof));
+    hashBytes(hash, Ap, (dof + 1) * sizeof(int));
+    hashBytes(hash, Ai, Ap[dof] * sizeof(int));
+    hashBytes(hash, Ax, Ap[dof] * sizeof(double));
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", hash);
+    return factorDir + "/" + name + "_" + hex + ".lu";
+}
+
+void LinearSolver::writeCSC(const std::string &filename) const
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    FormatBuffer out(&fout);
+    int nnz = Ap[dof];
+    for (int i = 0; i < dof + 1; i++)
+        out << Ap[i] << ' ';
+    out << '\n';
+    for (int i = 0; i < nnz; i++)
+        out << Ai[i] << ' ';
+    out << '\n';
+    for (int i = 0; i < nnz; i++)
+        out << Ax[i] << ' ';
+    out << '\n';
+}
+
+void LinearSolver::writeTriplet(const std::string &filename) const
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    FormatBuffer out(&fout);
+    for (int col = 0; col < dof; col++)
+        for (int k = Ap[col]; k < Ap[col + 1]; k++)
+            out << Ai[k] + 1 << ' ' << col + 1 << ' ' << Ax[k] << '\n';
+}
+
+void LinearSolver::writeMatrixMarket(const std::string &filename) const
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    FormatBuffer out(&fout, 17);
+    out << "%%MatrixMarket matrix coordinate real general\n" << dof << ' ' << dof << ' ' << Ap[dof] << '\n';
+    for (int col = 0; col < dof; col++)
+        for (int k = Ap[col]; k < Ap[col + 1]; k++)
+            out << Ai[k] + 1 << ' ' << col + 1 << ' ' << Ax[k] << '\n';
+}
+
+void LinearSolver::writeBinaryCSC(const std::string &filename) const
+{
+    std::ofstream fout(filename.c_str(), std::ios::binary);
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    int64_t size[2] = {dof, Ap[dof]};
+    fout.write("TRICSC1\n", 8);
+    fout.write(reinterpret_cast<const char *>(size), sizeof(size));
+    fout.write(reinterpret_cast<const char *>(Ap), (dof + 1) * sizeof(int));
+    fout.write(reinterpret_cast<const char *>(Ai), Ap[dof] * sizeof(int));
+    fout.write(reinterpret_cast<const char *>(Ax), Ap[dof] * sizeof(double));
+    if (!fout)
+        throw std::runtime_error("error writing " + filename);
+}
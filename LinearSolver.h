@@ -12,6 +12,8 @@
 #include <vector>
 #include <list>
 #include <iostream>
+#include <string>
+#include "RunReport.h"
 
 // #include "../SuperLU_4.3/SRC/slu_ddefs.h"
 
@@ -23,6 +25,22 @@ struct maColEle
     maColEle(int r, double v): row(r), value(v) {};
 };
 
+// what a solver did: the counts and times summed over its factorizations and solves, the other values
+// of the last ones, negative where the solver does not tell
+struct SolverStatistics {
+    long long nnz;
+    std::vector<long long> rowHistogram; // [0] rows without entries, [k] rows with 2^(k-1) to 2^k - 1 entries
+    int symbolicFactorizations, numericFactorizations, solves;
+    double symbolicSeconds, numericSeconds, solveSeconds;
+    double factorNonzeros;  // of L and U
+    double factorFlops, solveFlops;
+    double peakMB;          // memory of the solver at its peak
+    double rcond;           // estimate of the reciprocal condition number
+    double pivotGrowth;     // reciprocal pivot growth, small values mean an unstable factorization
+    double backwardError;   // of the last solve, max_i |b - A x|_i / (|A| |x| + |b|)_i
+    SolverStatistics();
+};
+
 
 class LinearSolver
 {
@@ -35,18 +53,57 @@ protected:
     int dof;    // degrees of freedom
     double *rh; // right-hand side vector
 
+    std::string factorDir; // where factorizations are saved and loaded, empty for neither
+    // factorDir/name_<hash of dof, Ap, Ai and Ax>.lu, empty without factorDir
+    std::string factorFile(const std::string &name) const;
+
     LinearSolver(std::vector< std::list<maColEle> > &ma,
                  int femDof, double *femRH);
+    LinearSolver(const std::string &stagedFile, int femDof, double *femRH); // map the file of OutOfCoreMatrix
+
+    void *mapped;      // the mapped staged file holding Ap, Ai and Ax, nullptr if they are allocated
+    size_t mappedSize;
+
+    bool keepFactors;  // keep the numeric factorization of solveSparse for solve
+
+    SolverStatistics stats;
+    bool printStats;   // print the statistics after each solveSparse
+    static std::vector<long long> rowHistogram(const std::vector<int> &rowNonzeros); // as in SolverStatistics
+    double backwardError(const double *b, const std::vector<double> &x) const;
+    // count a solve of A x = b and report the statistics, to the console too if print
+    void finishSolve(const double *b, const std::vector<double> &x, bool print);
 
 public:
     virtual std::vector<double> solveSparse() = 0; // solve the sparse linear system
+    int nonzeros() const { return Ap[dof]; }
+    
+    // take new values and right-hand side from ma if its pattern is unchanged,
+    // so the solver and its symbolic factorization can be reused; false otherwise
+    // and for a mapped matrix
+    bool updateValues(std::vector< std::list<maColEle> > &ma, int femDof, double *femRH);
+
+    // keep the numeric factorization of the next solveSparse, so that solve only does triangular solves
+    void setKeepFactorization(bool keep) { keepFactors = keep; }
+    // solve with right-hand side b by the factorization kept by the last solveSparse
+    virtual std::vector<double> solve(const std::vector<double> &b);
+
+    const SolverStatistics &statistics() const { return stats; }
+    void setPrintStatistics(bool print) { printStats = print; }
+    // set the statistics as run values of RunReport and print them to the console if toConsole
+    void reportStatistics(bool toConsole);
+
+    // save the numeric factorization to dir and load it from there in later runs with the same matrix
+    void setFactorDirectory(const std::string &dir) { factorDir = dir; }
+
+    // file output of the matrix, a distributed solver writes the rows of all processors into one file
+    void writeCSC(const std::string &filename) const;                  // text, lines Ap, Ai and Ax
+    void writeTriplet(const std::string &filename) const;              // text, lines "row col value", 1-based
+    virtual void writeMatrixMarket(const std::string &filename) const; // coordinate real general, exact doubles
+    // the 8 bytes "TRICSC1\n", int64 dof and nnz, int32 Ap[dof + 1], int32 Ai[nnz] and
+    // double Ax[nnz], in native byte order
+    virtual void writeBinaryCSC(const std::string &filename) const;
 
-    virtual ~LinearSolver()
-    {
-        delete [] Ap;
-        delete [] Ai;
-        delete [] Ax;
-    }
+    virtual ~LinearSolver();
 };
 
 
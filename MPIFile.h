@@ -0,0 +1,48 @@
+//
+//  MPIFile.h
+//  tri
+//
+//  One file written by all processors with MPI-IO.
+
+#ifndef __tri__MPIFile__
+#define __tri__MPIFile__
+
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <mpi.h>
+
+// open filename for writing by all processors of comm, truncated
+inline MPI_File openShared(MPI_Comm comm, const std::string &filename)
+{
+    MPI_File fh;
+    if (MPI_File_open(comm, const_cast<char *>(filename.c_str()), MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) != MPI_SUCCESS)
+        throw std::runtime_error("error opening " + filename);
+    MPI_File_set_size(fh, 0);
+    return fh;
+}
+
+// write n bytes at offset in blocks, as count is an int
+inline void writeBytesAt(MPI_File fh, MPI_Offset offset, const char *data, long long n)
+{
+    const long long block = 1 << 30;
+    for (long long pos = 0; pos < n; pos += block)
+        MPI_File_write_at(fh, offset + pos, const_cast<char *>(data + pos), (int) std::min(block, n - pos), MPI_CHAR, MPI_STATUS_IGNORE);
+}
+
+// the text of the processors one after the other, each writes at the sum of the lengths before it
+inline void writeShared(MPI_Comm comm, const std::string &filename, const char *text, long long length)
+{
+    int rank;
+    long long offset(0);
+    MPI_Comm_rank(comm, &rank);
+    MPI_Exscan(&length, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0)
+        offset = 0;
+    
+    MPI_File fh = openShared(comm, filename);
+    writeBytesAt(fh, offset, text, length);
+    MPI_File_close(&fh);
+}
+
+#endif /* defined(__tri__MPIFile__) */
@@ -7,6 +7,9 @@
 //
 
 #include "Mesh.h"
+#include "SquareMesh.h"
+#include <algorithm>
+#include <map>
 
 using std::vector;
 
@@ -20,27 +23,35 @@ Mesh::Mesh(Problem* prob)
         _dimension = prob -> dimension;
         
         
-        initEdge();
+        if (prob -> parameters.squareN > 0) {
+            generateSquare(prob -> parameters.squareN, prob -> parameters.squareM,
+                           prob -> parameters.squareZ, prob -> parameters.nRefine);
 #ifdef __MESH_DEBUG
-        std::cout << " edge initialized" << std::endl;
+            std::cout << " square mesh generated" << std::endl;
 #endif
-        
-        initElement();
+        } else {
+            initEdge();
 #ifdef __MESH_DEBUG
-        std::cout << " element initialized" << std::endl;
+            std::cout << " edge initialized" << std::endl;
 #endif
-        
-        initVertex();
+            
+            initElement();
 #ifdef __MESH_DEBUG
-        std::cout << " vertex initialized" << std::endl;
+            std::cout << " element initialized" << std::endl;
 #endif
-        findElementEdge(0);
-        
-        if (prob -> parameters.nRefine > 0) {
-            readRefinement(prob -> parameters.nRefine);
+            
+            initVertex();
 #ifdef __MESH_DEBUG
-            std::cout << " refinement initialized" << std::endl;
+            std::cout << " vertex initialized" << std::endl;
 #endif
+            findElementEdge(0);
+            
+            if (prob -> parameters.nRefine > 0) {
+                readRefinement(prob -> parameters.nRefine);
+#ifdef __MESH_DEBUG
+                std::cout << " refinement initialized" << std::endl;
+#endif
+            }
         }
         
 #ifdef __MESH_DEBUG
@@ -60,6 +71,7 @@ Mesh::Mesh(Problem* prob)
 
 int Mesh::initElement()
 {
+    PhaseTimer timer(Phase::MeshParsing);
     std::ifstream fin((_meshFilename + ".ele").c_str());
     if (!fin)
         throw std::runtime_error("error opening " + _meshFilename + ".ele");
@@ -91,6 +103,7 @@ int Mesh::initElement()
 
 int Mesh::initEdge()
 {
+    PhaseTimer timer(Phase::MeshParsing);
     std::ifstream fin((_meshFilename + ".edge").c_str());
     if (!fin)
         throw std::runtime_error("error opening " + _meshFilename + ".edge");
@@ -106,6 +119,9 @@ int Mesh::initEdge()
             fin >> it -> vertex[j];
         fin >> it -> bctype;
         it -> reftype = -1;
+        it -> parent = 0;
+        it -> t0 = 0;
+        it -> t1 = 1;
     }
     
     return 0;
@@ -113,6 +129,7 @@ int Mesh::initEdge()
 
 int Mesh::initVertex()
 {
+    PhaseTimer timer(Phase::MeshParsing);
     int numVer, dim, numAttr, numBound;
     std::ifstream fin((_meshFilename + ".node").c_str());
     if (!fin)
@@ -139,6 +156,7 @@ int Mesh::initVertex()
 
 int Mesh::readRefinement(int nRefine)
 {
+    PhaseTimer timer(Phase::Refinement);
     for (int refineLevel = 0; refineLevel < nRefine; refineLevel++) {
         std::string refFile = _meshFilename + ".ref" + std::to_string(refineLevel);
         std::ifstream fin(refFile.c_str());
@@ -157,15 +175,16 @@ int Mesh::readRefinement(int nRefine)
         }
         
         // read refinement info on edge
-        int numNewEdge, tempEdgeIndex, tempVertex, parentEdge, j(0);
+        int numNewEdge, tempEdgeIndex, tempVertex, parentEdge(0), j(0);
         vector<Edge>::size_type sizeEdge = edge.size();
         fin >> numNewEdge;
         
         Edge *pEdge;
         while (j < numNewEdge) {
             fin >> tempEdgeIndex;
-            if (tempEdgeIndex <= sizeEdge) {
-                edge[tempEdgeIndex - 1].reftype = refineLevel;
+            if (tempEdgeIndex <= (int) sizeEdge) { // parent 0 heads the new edges inside refined elements
+                if (tempEdgeIndex > 0)
+                    edge[tempEdgeIndex - 1].reftype = refineLevel;
                 parentEdge = tempEdgeIndex;
             } else {
                 pEdge = new Edge;
@@ -176,6 +195,9 @@ int Mesh::readRefinement(int nRefine)
                 }
                 
                 pEdge -> reftype = -1;
+                pEdge -> parent = parentEdge;
+                pEdge -> t0 = 0;
+                pEdge -> t1 = 1;
                 if (parentEdge > 0) {
                     pEdge -> neighborElement = edge[parentEdge - 1].neighborElement;
                     pEdge -> bctype = edge[parentEdge - 1].bctype;
@@ -187,6 +209,7 @@ int Mesh::readRefinement(int nRefine)
                 ++j;
             }
         }
+        placeSplitEdges(sizeEdge);
         
         // read refinement info on element
         int numNewEle, tempEleIndex, parentIndex;
@@ -225,13 +248,29 @@ int Mesh::readRefinement(int nRefine)
 
 void Mesh::findElementEdge(vector<Edge>::size_type previousLevelElementSize)
 {
+    PhaseTimer timer(Phase::Connectivity);
+    // edges sorted by their vertex pair, the edges of an element are found by binary search
+    typedef std::pair<std::pair<int, int>, int> EdgeKey;
+    vector<EdgeKey> edgeKey(edge.size());
+    for (vector<Edge>::size_type i = 0; i < edge.size(); i++)
+        edgeKey[i] = EdgeKey(std::minmax(edge[i].vertex[0], edge[i].vertex[1]), i);
+    std::sort(edgeKey.begin(), edgeKey.end());
+    
+    vector<int> found;
     for (auto i = previousLevelElementSize; i < element.size(); i++) {
         Element &ele = element[i];
-        for (Edge &ed : edge) {
-            if (std::find(ele.vertex.begin(), ele.vertex.end(), ed.vertex[0]) == ele.vertex.end())
-                continue;
-            if (std::find(ele.vertex.begin(), ele.vertex.end(), ed.vertex[1]) == ele.vertex.end())
-                continue;
+        found.clear();
+        for (vector<int>::size_type a = 0; a < ele.vertex.size(); a++)
+            for (vector<int>::size_type b = a + 1; b < ele.vertex.size(); b++) {
+                EdgeKey key(std::minmax(ele.vertex[a], ele.vertex[b]), 0);
+                for (auto it = std::lower_bound(edgeKey.begin(), edgeKey.end(), key);
+                     it != edgeKey.end() && it -> first == key.first; it++)
+                    found.push_back(it -> second);
+            }
+        std::sort(found.begin(), found.end()); // in the order of edge
+        
+        for (int k : found) {
+            Edge &ed = edge[k];
             ele.edge.push_back(ed.index);
             
             if ( (ed.bctype == 0 && ed.neighborElement.size() < 2) || (ed.bctype != 0 && ed.neighborElement.size() == 0))
@@ -251,6 +290,302 @@ void Mesh::findElementEdge(vector<Edge>::size_type previousLevelElementSize)
     }
 }
 
+void Mesh::generateSquare(int n, int m, int z, int nRefine)
+{
+    PhaseTimer timer(Phase::MeshGeneration);
+    SquareMeshGenerator gen(n, m, z);
+    for (int level = 0; level < nRefine; level++)
+        gen.refine();
+    
+    vertex.resize(gen.numCoarseNode());
+    for (int i = 0; i < gen.numCoarseNode(); i++) {
+        SquareMeshGenerator::Node node = gen.coarseNode(i + 1);
+        vertex[i].index = node.index;
+        vertex[i].dofIndex = 0;
+        vertex[i].x = node.x;
+        vertex[i].y = node.y;
+        vertex[i].bctype = node.bctype;
+    }
+    
+    edge.resize(gen.numCoarseEdge());
+    for (int i = 0; i < gen.numCoarseEdge(); i++) {
+        SquareMeshGenerator::Edge ed = gen.coarseEdge(i + 1);
+        edge[i].index = ed.index;
+        edge[i].vertex = vector<int> {ed.v1, ed.v2};
+        edge[i].bctype = ed.bctype;
+        edge[i].reftype = constNonrefined;
+        edge[i].parent = 0;
+        edge[i].t0 = 0;
+        edge[i].t1 = 1;
+    }
+    
+    element.resize(gen.numCoarseElement());
+    for (int i = 0; i < gen.numCoarseElement(); i++) {
+        SquareMeshGenerator::Element ele = gen.coarseElement(i + 1);
+        element[i].index = ele.index;
+        element[i].vertex = vector<int> {ele.v1, ele.v2, ele.v3};
+        element[i].reftype = constNonrefined;
+        element[i].localDof = 0;
+        element[i].dofIndex = 0;
+        element[i].detBE = 0;
+        element[i].parent = 0;
+    }
+    findElementEdge(0);
+    
+    // refinement levels, set up as readRefinement does
+    for (int refineLevel = 0; refineLevel < nRefine; refineLevel++) {
+        for (const SquareMeshGenerator::Node &node : gen.refNode(refineLevel)) {
+            Vertex ver = {node.index, 0, node.x, node.y, node.bctype};
+            vertex.push_back(ver);
+        }
+        
+        vector<Edge>::size_type sizeEdge = edge.size();
+        for (const SquareMeshGenerator::Edge &ed : gen.refEdge(refineLevel)) {
+            Edge newEdge;
+            newEdge.index = ed.index;
+            newEdge.vertex = vector<int> {ed.v1, ed.v2};
+            newEdge.reftype = constNonrefined;
+            newEdge.parent = ed.parent;
+            newEdge.t0 = 0;
+            newEdge.t1 = 1;
+            if (ed.parent > 0) {
+                Edge &parent = edge[ed.parent - 1];
+                parent.reftype = refineLevel;
+                newEdge.neighborElement = parent.neighborElement;
+                newEdge.bctype = parent.bctype;
+            } else
+                newEdge.bctype = 0;
+            edge.push_back(newEdge);
+        }
+        placeSplitEdges(sizeEdge);
+        
+        vector<Element>::size_type sizeEle = element.size();
+        for (const SquareMeshGenerator::Element &ele : gen.refElement(refineLevel)) {
+            Element newEle;
+            newEle.index = ele.index;
+            newEle.vertex = vector<int> {ele.v1, ele.v2, ele.v3};
+            newEle.reftype = constNonrefined;
+            newEle.localDof = 0;
+            newEle.dofIndex = 0;
+            newEle.detBE = 0;
+            newEle.parent = ele.parent;
+            element.push_back(newEle);
+            element[ele.parent - 1].reftype = refineLevel;
+            element[ele.parent - 1].child.push_back(ele.index);
+        }
+        
+        findElementEdge(sizeEle);
+    }
+}
+
+void Mesh::refineElements(const vector<int> &marked, int refineLevel)
+{
+    PhaseTimer timer(Phase::Refinement);
+    // leaf edges on the boundary of each element
+    vector< vector<int> > elementEdges(element.size());
+    for (Edge &ed : edge)
+        if (ed.reftype == constNonrefined)
+            for (int iEle : ed.neighborElement)
+                elementEdges[iEle - 1].push_back(ed.index);
+    
+    vector<Element>::size_type sizeEle = element.size();
+    for (int iEle : marked) {
+        vector<int> ver = element[iEle - 1].vertex;
+        vector<int> mid(3);
+        for (int k = 0; k < 3; k++)
+            mid[k] = splitSide(ver[k], ver[(k + 1) % 3], elementEdges, iEle, refineLevel);
+        
+        for (int k = 0; k < 3; k++) {
+            Edge inner;
+            inner.index = edge.size() + 1;
+            inner.reftype = constNonrefined;
+            inner.bctype = 0;
+            inner.vertex = vector<int> {mid[k], mid[(k + 1) % 3]};
+            inner.parent = 0;
+            inner.t0 = 0;
+            inner.t1 = 1;
+            edge.push_back(inner);
+        }
+        
+        vector< vector<int> > children {
+            {ver[0], mid[0], mid[2]}, {mid[0], ver[1], mid[1]},
+            {mid[2], mid[1], ver[2]}, {mid[0], mid[1], mid[2]}
+        };
+        element[iEle - 1].reftype = refineLevel;
+        for (vector<int> &c : children) {
+            Element ele;
+            ele.index = element.size() + 1;
+            ele.vertex = c;
+            ele.reftype = constNonrefined;
+            ele.localDof = 0;
+            ele.dofIndex = 0;
+            ele.detBE = 0;
+            ele.parent = iEle;
+            element.push_back(ele);
+            element[iEle - 1].child.push_back(ele.index);
+        }
+    }
+    
+    findElementEdge(sizeEle);
+    
+    // leaf edges shorter than the sides of the children still name the refined element
+    for (int iEle : marked)
+        for (int iEdge : elementEdges[iEle - 1]) {
+            Edge &ed = edge[iEdge - 1];
+            if (ed.reftype != constNonrefined)
+                continue;
+            std::vector<int>::iterator it = std::find(ed.neighborElement.begin(), ed.neighborElement.end(), iEle);
+            if (it == ed.neighborElement.end())
+                continue;
+            Vertex &v1 = vertex[ed.vertex[0] - 1];
+            Vertex &v2 = vertex[ed.vertex[1] - 1];
+            *it = childContaining(iEle, (v1.x + v2.x) / 2, (v1.y + v2.y) / 2);
+        }
+}
+
+// the midpoint of side (a, b) of element iEle; a leaf edge (a, b) is split in two as readRefinement does.
+// If the side was split before, its pieces are the ancestors right below it of the leaf edges of iEle,
+// and the midpoint is where the chain of pieces from its vertex[0] is half through; more than two
+// pieces are put under two new halves of the side, so that each side of the children is an edge
+int Mesh::splitSide(int a, int b, vector< vector<int> > &elementEdges, int iEle, int refineLevel)
+{
+    auto isSide = [a, b](const Edge &ed) {
+        return (ed.vertex[0] == a && ed.vertex[1] == b) || (ed.vertex[0] == b && ed.vertex[1] == a);
+    };
+    
+    int side(0), mid(0);
+    vector<int> pieces, firstHalf;
+    for (int iEdge : elementEdges[iEle - 1]) {
+        Edge &ed = edge[iEdge - 1];
+        if (ed.reftype != constNonrefined)
+            continue;
+        if (isSide(ed)) {
+            side = iEdge;
+            continue;
+        }
+        for (int piece = iEdge, p = ed.parent; p > 0; piece = p, p = edge[p - 1].parent)
+            if (isSide(edge[p - 1])) {
+                if (std::find(pieces.begin(), pieces.end(), piece) == pieces.end())
+                    pieces.push_back(piece);
+                break;
+            }
+    }
+    
+    // a leaf side gets a new vertex at its midpoint and is split into two halves below
+    if (pieces.empty()) {
+        if (side == 0)
+            throw std::runtime_error("element " + std::to_string(iEle) + " has no leaf edges on a side");
+        double midx = (vertex[a - 1].x + vertex[b - 1].x) / 2;
+        double midy = (vertex[a - 1].y + vertex[b - 1].y) / 2;
+        Vertex ver = {(int) vertex.size() + 1, 0, midx, midy, side > 0 ? edge[side - 1].bctype : 0};
+        vertex.push_back(ver);
+        mid = ver.index;
+    } else {
+        if (pieces.size() % 2 != 0)
+            throw std::runtime_error("element " + std::to_string(iEle) + " cannot be refined, a side is split into "
+                                     + std::to_string(pieces.size()) + " pieces and has no vertex at its midpoint");
+        side = edge[pieces[0] - 1].parent;
+        int previous = 0;
+        mid = edge[side - 1].vertex[0];
+        for (vector<int>::size_type k = 0; k < pieces.size() / 2; k++)
+            for (int piece : pieces) {
+                const vector<int> &pv = edge[piece - 1].vertex;
+                if (piece != previous && (pv[0] == mid || pv[1] == mid)) {
+                    mid = pv[0] == mid ? pv[1] : pv[0];
+                    previous = piece;
+                    firstHalf.push_back(piece);
+                    break;
+                }
+            }
+        if (pieces.size() == 2)
+            return mid;
+    }
+    
+    // the halves of side, leaves unless they take over the pieces of side
+    int firstHalfIndex = edge.size() + 1;
+    for (int k = 0; k < 2; k++) {
+        Edge half;
+        half.index = edge.size() + 1;
+        half.reftype = pieces.empty() ? constNonrefined : refineLevel;
+        half.bctype = edge[side - 1].bctype;
+        half.vertex = k == 0 ? vector<int> {edge[side - 1].vertex[0], mid} : vector<int> {mid, edge[side - 1].vertex[1]};
+        half.neighborElement = edge[side - 1].neighborElement;
+        half.parent = side;
+        half.t0 = 0.5 * k;
+        half.t1 = 0.5 * (k + 1);
+        edge.push_back(half);
+        if (pieces.empty())
+            for (int jEle : half.neighborElement)
+                elementEdges[jEle - 1].push_back(half.index);
+    }
+    if (pieces.empty())
+        edge[side - 1].reftype = refineLevel;
+    
+    // where the pieces lie on their half, exactly as the doubling is exact
+    for (int piece : pieces) {
+        Edge &ed = edge[piece - 1];
+        bool first = std::find(firstHalf.begin(), firstHalf.end(), piece) != firstHalf.end();
+        ed.parent = first ? firstHalfIndex : firstHalfIndex + 1;
+        ed.t0 = first ? 2 * ed.t0 : 2 * ed.t0 - 1;
+        ed.t1 = first ? 2 * ed.t1 : 2 * ed.t1 - 1;
+    }
+    
+    return mid;
+}
+
+// t0 and t1 of the new edges from firstNewEdge on that split an edge, by following the chain
+// of pieces of each split edge from its vertex[0]; the pieces are equally long, as meshgen
+// and refineElements make them
+void Mesh::placeSplitEdges(vector<Edge>::size_type firstNewEdge)
+{
+    std::map< int, vector<int> > pieces; // split edge -> indices of its new edges
+    for (vector<Edge>::size_type i = firstNewEdge; i < edge.size(); i++)
+        if (edge[i].parent > 0)
+            pieces[edge[i].parent].push_back(edge[i].index);
+    
+    for (std::pair< const int, vector<int> > &split : pieces) {
+        vector<int> &piece = split.second;
+        int n = piece.size(), at = edge[split.first - 1].vertex[0];
+        for (int k = 0; k < n; k++) {
+            int next = k;
+            while (next < n && edge[piece[next] - 1].vertex[0] != at && edge[piece[next] - 1].vertex[1] != at)
+                ++next;
+            if (next == n)
+                throw std::runtime_error("the new edges of edge " + std::to_string(split.first) + " do not cover it");
+            std::swap(piece[k], piece[next]);
+            Edge &ed = edge[piece[k] - 1];
+            bool forward = ed.vertex[0] == at;
+            ed.t0 = (double) (forward ? k : k + 1) / n;
+            ed.t1 = (double) (forward ? k + 1 : k) / n;
+            at = forward ? ed.vertex[1] : ed.vertex[0];
+        }
+        if (at != edge[split.first - 1].vertex[1])
+            throw std::runtime_error("the new edges of edge " + std::to_string(split.first) + " do not cover it");
+    }
+}
+
+// the child of element iEle that (x, y) lies in
+int Mesh::childContaining(int iEle, double x, double y)
+{
+    int best(0);
+    double bestLambda(-1e300);
+    for (int iChild : element[iEle - 1].child) {
+        Element &ele = element[iChild - 1];
+        double x1(vertex[ele.vertex[0] - 1].x), y1(vertex[ele.vertex[0] - 1].y),
+        x2(vertex[ele.vertex[1] - 1].x), y2(vertex[ele.vertex[1] - 1].y),
+        x3(vertex[ele.vertex[2] - 1].x), y3(vertex[ele.vertex[2] - 1].y);
+        double det = (x2 - x1) * (y3 - y1) - (x3 - x1) * (y2 - y1);
+        double lambda2 = ((x - x1) * (y3 - y1) - (x3 - x1) * (y - y1)) / det;
+        double lambda3 = ((x2 - x1) * (y - y1) - (x - x1) * (y2 - y1)) / det;
+        double lambda = std::min(std::min(lambda2, lambda3), 1 - lambda2 - lambda3); // smallest barycentric coordinate
+        if (lambda > bestLambda) {
+            bestLambda = lambda;
+            best = iChild;
+        }
+    }
+    return best;
+}
+
 void Mesh::printVertex()
 {
     std::cout << "vertex:" << std::endl;
@@ -289,9 +624,10 @@ void Mesh::printElement()
     std::cout << "index\t" << "reftype\t" << "vertex\t\t" << "edge\t\t" << "parent\t" << "child" << std::endl;
     for (Element ele : element) {
         std::cout << ele.index << "\t" << ele.reftype << "\t"
-        << ele.vertex[0] << "   " << ele.vertex[1] << "   " << ele.vertex[2] << "\t"
-        << ele.edge[0] << "   " << ele.edge[1] << "   " << ele.edge[2] << "\t"
-        << ele.parent << "\t";
+        << ele.vertex[0] << "   " << ele.vertex[1] << "   " << ele.vertex[2] << "\t";
+        for (std::vector<int>::size_type k = 0; k < ele.edge.size(); k++) // children made by refineElements may miss a side
+            std::cout << (k ? "   " : "") << ele.edge[k];
+        std::cout << "\t" << ele.parent << "\t";
         for (int jChild : ele.child)
             std::cout << jChild << " ";
         std::cout << std::endl;
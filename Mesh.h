@@ -15,6 +15,7 @@
 #include <fstream>
 #include <cstring>
 #include "problem.h"
+#include "RunReport.h"
 
 struct Vertex {
     int index;
@@ -31,6 +32,8 @@ struct Edge {
     int bctype;                        // boundary condition type, 0 for interior vertex, 1 for dirichlet boundary, 2 for neumann boundary
     std::vector<int> vertex;           // indices of its vertices
     std::vector<int> neighborElement;  // indices of elements sharing the edge
+    int parent;                        // index of the edge it was split from, 0 if none
+    double t0, t1;                     // where vertex[0] and vertex[1] lie on the parent, 0 at its vertex[0] and 1 at its vertex[1]
 };
 
 struct Element {
@@ -58,7 +61,16 @@ class Mesh {
     int initEdge();
     int initVertex();
     int readRefinement(int);
+    int splitSide(int a, int b, std::vector< std::vector<int> > &elementEdges, int iEle, int refineLevel);
+    int childContaining(int iEle, double x, double y);
+    void placeSplitEdges(std::vector<Edge>::size_type firstNewEdge);
+public:
+    // find the edges of elements from previousLevelElementSize on and update neighbor elements of edges
     void findElementEdge(std::vector<Edge>::size_type previousLevelElementSize);
+    // fill the empty mesh with the square mesh of meshgen n m z and nRefine of its refinement levels
+    void generateSquare(int n, int m, int z, int nRefine);
+    // red-refine the marked leaf elements into four each, as refinement level refineLevel
+    void refineElements(const std::vector<int> &marked, int refineLevel);
 public:
     void printVertex();
     void printEdge();
@@ -81,6 +93,7 @@ public:
     std::vector<Edge> edge;
     std::vector<Vertex> vertex;
     
+    Mesh(): _dimension(2) {} // empty mesh, to be filled in code
     Mesh(Problem* prob);
     
 };
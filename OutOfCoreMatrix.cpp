@@ -0,0 +1,244 @@
+//
+//  OutOfCoreMatrix.cpp
+//  tri
+//
+
+#include "OutOfCoreMatrix.h"
+#include "RunReport.h"
+#include <fstream>
+#include <algorithm>
+#include <queue>
+#include <memory>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+
+using std::vector;
+using std::string;
+
+typedef OutOfCoreMatrix::Entry Entry;
+typedef vector<Entry>::size_type size_type;
+
+namespace {
+    bool before(const Entry &a, const Entry &b)
+    {
+        return a.col < b.col || (a.col == b.col && a.row < b.row);
+    }
+    
+    // the entries of a run, read in blocks
+    class RunReader {
+        std::ifstream in;
+        vector<Entry> block;
+        size_type pos;
+    public:
+        RunReader(const string &name, size_type blockEntries): in(name.c_str(), std::ios::binary), pos(0)
+        {
+            if (!in)
+                throw std::runtime_error("error opening " + name);
+            block.reserve(blockEntries);
+        }
+        bool next(Entry &e)
+        {
+            if (pos == block.size()) {
+                block.resize(block.capacity());
+                in.read(reinterpret_cast<char *>(block.data()), block.size() * sizeof(Entry));
+                block.resize(in.gcount() / sizeof(Entry));
+                pos = 0;
+                if (block.empty())
+                    return false;
+            }
+            e = block[pos++];
+            return true;
+        }
+    };
+    
+    template <typename T>
+    class BlockWriter {
+        std::ostream &out;
+        vector<T> block;
+    public:
+        BlockWriter(std::ostream &o, size_type blockEntries): out(o) { block.reserve(blockEntries); }
+        ~BlockWriter() { flush(); }
+        void put(const T &v)
+        {
+            block.push_back(v);
+            if (block.size() == block.capacity())
+                flush();
+        }
+        void flush()
+        {
+            out.write(reinterpret_cast<const char *>(block.data()), block.size() * sizeof(T));
+            block.clear();
+        }
+    };
+    
+    // the entries of all runs in order, equal entries summed in the order of the runs
+    template <typename Emit>
+    void mergeRuns(const vector<string> &names, size_type blockEntries, Emit emit)
+    {
+        typedef std::pair<Entry, int> Head;
+        auto later = [](const Head &a, const Head &b) {
+            return before(b.first, a.first) || (!before(a.first, b.first) && a.second > b.second);
+        };
+        std::priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+        vector< std::unique_ptr<RunReader> > readers;
+        Entry e;
+        for (vector<string>::size_type i = 0; i < names.size(); i++) {
+            readers.emplace_back(new RunReader(names[i], blockEntries));
+            if (readers[i] -> next(e))
+                heads.push(Head(e, i));
+        }
+        
+        bool open = false;
+        Entry current = Entry();
+        while (!heads.empty()) {
+            Head head = heads.top();
+            heads.pop();
+            if (open && head.first.row == current.row && head.first.col == current.col)
+                current.value += head.first.value;
+            else {
+                if (open)
+                    emit(current);
+                current = head.first;
+                open = true;
+            }
+            if (readers[head.second] -> next(e))
+                heads.push(Head(e, head.second));
+        }
+        if (open)
+            emit(current);
+    }
+}
+
+OutOfCoreMatrix::OutOfCoreMatrix(const string &scratchBase, long long budgetBytes):
+    base(scratchBase), runCount(0)
+{
+    capacity = std::max<long long>(budgetBytes / sizeof(Entry), 1 << 16);
+    buffer.reserve(capacity);
+}
+
+OutOfCoreMatrix::~OutOfCoreMatrix()
+{
+    for (const string &name : runs)
+        std::remove(name.c_str());
+    if (!staged.empty())
+        std::remove(staged.c_str());
+}
+
+long long OutOfCoreMatrix::valueOffset(int dof)
+{
+    long long end = 8 + 2 * sizeof(int64_t) + (dof + 1LL) * sizeof(int32_t);
+    return (end + 7) / 8 * 8;
+}
+
+string OutOfCoreMatrix::nextRunName()
+{
+    return base + ".run" + std::to_string(runCount++);
+}
+
+// sorted with equal entries summed in the order they were added
+void OutOfCoreMatrix::writeRun()
+{
+    std::stable_sort(buffer.begin(), buffer.end(), before);
+    size_type n = 0;
+    for (size_type k = 0; k < buffer.size(); k++) {
+        if (n > 0 && buffer[k].row == buffer[n - 1].row && buffer[k].col == buffer[n - 1].col)
+            buffer[n - 1].value += buffer[k].value;
+        else
+            buffer[n++] = buffer[k];
+    }
+    
+    string name = nextRunName();
+    std::ofstream out(name.c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char *>(buffer.data()), n * sizeof(Entry));
+    if (!out)
+        throw std::runtime_error("error writing " + name);
+    runs.push_back(name);
+    buffer.clear();
+}
+
+// the budget holds the read blocks of the runs merged at once and the write blocks,
+// more runs are merged in passes
+const string &OutOfCoreMatrix::finish(int dof)
+{
+    if (!buffer.empty() || runs.empty())
+        writeRun();
+    vector<Entry>().swap(buffer);
+    
+    size_type blockEntries = std::max<size_type>(1024, std::min<size_type>(1 << 16, capacity / 8));
+    size_type fanIn = std::max<size_type>(2, capacity / blockEntries - 2);
+    while (runs.size() > fanIn) {
+        vector<string> inputs(runs.begin(), runs.begin() + fanIn);
+        runs.erase(runs.begin(), runs.begin() + fanIn);
+        mergeToRun(inputs, blockEntries);
+    }
+    mergeToCSC(dof, blockEntries);
+    RunReport::setValue("staging_runs", runCount);
+    return staged;
+}
+
+void OutOfCoreMatrix::mergeToRun(const vector<string> &inputs, size_type blockEntries)
+{
+    string name = nextRunName();
+    std::ofstream out(name.c_str(), std::ios::binary);
+    BlockWriter<Entry> entries(out, blockEntries);
+    mergeRuns(inputs, blockEntries, [&entries](const Entry &e) { entries.put(e); });
+    entries.flush();
+    if (!out)
+        throw std::runtime_error("error writing " + name);
+    for (const string &input : inputs)
+        std::remove(input.c_str());
+    runs.push_back(name);
+}
+
+// the values go to the staged file as they are merged and the rows to a scratch
+// file appended after them; Ap is counted in memory and written last
+void OutOfCoreMatrix::mergeToCSC(int dof, size_type blockEntries)
+{
+    staged = base + ".csc";
+    std::ofstream out(staged.c_str(), std::ios::binary);
+    if (!out)
+        throw std::runtime_error("error opening " + staged);
+    vector<char> zeros(valueOffset(dof), 0);
+    out.write(zeros.data(), zeros.size());
+    
+    string rowName = nextRunName();
+    std::ofstream rowOut(rowName.c_str(), std::ios::binary);
+    vector<int> Ap(dof + 1, 0);
+    long long nnz = 0;
+    {
+        BlockWriter<double> values(out, blockEntries);
+        BlockWriter<int32_t> rows(rowOut, blockEntries);
+        mergeRuns(runs, blockEntries, [&](const Entry &e) {
+            values.put(e.value);
+            rows.put(e.row);
+            Ap[e.col + 1]++;
+            nnz++;
+        });
+    }
+    rowOut.close();
+    if (nnz > INT_MAX)
+        throw std::runtime_error("the staged matrix has more than INT_MAX nonzeros");
+    for (int col = 0; col < dof; col++)
+        Ap[col + 1] += Ap[col];
+    
+    std::ifstream rowIn(rowName.c_str(), std::ios::binary);
+    vector<char> block(blockEntries * sizeof(Entry));
+    while (rowIn.read(block.data(), block.size()) || rowIn.gcount() > 0)
+        out.write(block.data(), rowIn.gcount());
+    rowIn.close();
+    std::remove(rowName.c_str());
+    
+    int64_t size[2] = {dof, nnz};
+    out.seekp(0);
+    out.write("TRIOOC1\n", 8);
+    out.write(reinterpret_cast<const char *>(size), sizeof(size));
+    out.write(reinterpret_cast<const char *>(Ap.data()), Ap.size() * sizeof(int));
+    if (!out)
+        throw std::runtime_error("error writing " + staged);
+    
+    for (const string &name : runs)
+        std::remove(name.c_str());
+    runs.clear();
+}
@@ -0,0 +1,56 @@
+//
+//  OutOfCoreMatrix.h
+//  tri
+//
+//  The stiffness matrix assembled out of core. Contributions are buffered
+// up to a memory budget, sorted by column and row and written as runs to
+// scratch files, which are merged, summing equal entries, into one staged
+// file in compressed column form that the solvers map into memory.
+//  Layout of the staged file, in native byte order: the 8 bytes "TRIOOC1\n",
+// int64 dof and nnz, int32 Ap[dof + 1], zeros up to a multiple of 8 bytes,
+// double Ax[nnz] and int32 Ai[nnz].
+
+#ifndef __tri__OutOfCoreMatrix__
+#define __tri__OutOfCoreMatrix__
+
+#include <string>
+#include <vector>
+
+class OutOfCoreMatrix {
+public:
+    struct Entry {
+        int row, col;
+        double value;
+    };
+    
+    // scratch files are named scratchBase.runK and scratchBase.csc
+    OutOfCoreMatrix(const std::string &scratchBase, long long budgetBytes);
+    ~OutOfCoreMatrix(); // removes the scratch files, a mapping of the staged file stays valid
+    
+    void add(int row, int col, double value)
+    {
+        buffer.push_back(Entry{row, col, value});
+        if (buffer.size() >= capacity)
+            writeRun();
+    }
+    
+    // merge the runs into the staged file and return its name
+    const std::string &finish(int dof);
+    
+    static long long valueOffset(int dof); // of Ax in the staged file
+    
+private:
+    std::string base;
+    std::vector<Entry>::size_type capacity; // entries buffered before a run is written
+    std::vector<Entry> buffer;
+    std::vector<std::string> runs;
+    int runCount;  // runs written, including those of intermediate merges
+    std::string staged;
+    
+    void writeRun();
+    std::string nextRunName();
+    void mergeToRun(const std::vector<std::string> &inputs, std::vector<Entry>::size_type blockEntries);
+    void mergeToCSC(int dof, std::vector<Entry>::size_type blockEntries);
+};
+
+#endif /* defined(__tri__OutOfCoreMatrix__) */
@@ -0,0 +1,59 @@
+//
+//  Parallel.h
+//  tri
+//
+//  A parallel loop over independent items with std::thread. The number
+// of threads is OMP_NUM_THREADS if set, as triscale.py sets it, and the
+// number of hardware threads otherwise.
+
+#ifndef __tri__Parallel__
+#define __tri__Parallel__
+
+#include <thread>
+#include <vector>
+#include <cstdlib>
+#include <algorithm>
+#include <exception>
+
+inline int numThreads()
+{
+    const char *env = getenv("OMP_NUM_THREADS");
+    int n = env ? atoi(env) : (int) std::thread::hardware_concurrency();
+    return std::max(n, 1);
+}
+
+// body(i) for 0 <= i < n, in contiguous chunks; small loops run in the calling thread
+template <typename F>
+void parallelFor(int n, F body)
+{
+    const int minChunk = 4096;
+    int nThreads = std::min(numThreads(), (n + minChunk - 1) / minChunk);
+    if (nThreads <= 1) {
+        for (int i = 0; i < n; i++)
+            body(i);
+        return;
+    }
+
+    // an exception of body stops its chunk and is rethrown here once all threads are joined
+    std::vector<std::exception_ptr> errors(nThreads);
+    std::vector<std::thread> threads;
+    int chunk = (n + nThreads - 1) / nThreads;
+    auto runChunk = [&errors, &body, n, chunk](int t) {
+        try {
+            for (int i = t * chunk; i < std::min(n, (t + 1) * chunk); i++)
+                body(i);
+        } catch (...) {
+            errors[t] = std::current_exception();
+        }
+    };
+    for (int t = 1; t < nThreads; t++)
+        threads.push_back(std::thread(runChunk, t));
+    runChunk(0);
+    for (std::thread &thread : threads)
+        thread.join();
+    for (std::exception_ptr &error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+#endif /* defined(__tri__Parallel__) */
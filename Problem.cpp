@@ -7,15 +7,81 @@
 //
 
 #include "Problem.h"
+#include <sstream>
+#include <algorithm>
 
 using std::cout;
 using std::endl;
 using std::getline;
 using std::string;
 
+// read a parameter that older input files may not have, keep value if absent
+template <typename T>
+static void readOptional(std::ifstream &fin, T &value)
+{
+    T temp;
+    if (fin >> temp)
+        value = temp;
+    string tempStr;
+    getline(fin, tempStr);
+}
+
+// read an expression line up to its comment, keep value if absent or empty
+static void readExpression(std::ifstream &fin, string &value)
+{
+    string line;
+    if (!getline(fin, line))
+        return;
+    line = line.substr(0, line.find('#'));
+    size_t first = line.find_first_not_of(" \t\r"), last = line.find_last_not_of(" \t\r");
+    if (first != string::npos)
+        value = line.substr(first, last - first + 1);
+}
+
+// default parameters, for problems set up in code rather than by an input file
+Problem::Problem()
+{
+    parameters.squareN = 0;
+    parameters.squareM = 3;
+    parameters.squareZ = 3;
+    parameters.nRefine = 0;
+    parameters.solPack = static_cast<SolPack>(DEFAULT_SOLVE_PACK);
+    parameters.cprintMeshInfo = 0;
+    parameters.cprintError = 0;
+    parameters.printResults = 0;
+    parameters.fprintResults = 0;
+    parameters.fprintMA = 0;
+    parameters.fprintRH = 0;
+    parameters.fprintTriplet = 0;
+    parameters.fprintReport = 0;
+    parameters.nAdaptive = 0;
+    parameters.theta = 0.5;
+    parameters.adaptiveTol = 0;
+    parameters.problemName = "quadratic";
+    parameters.fExpression = "0";
+    parameters.gdExpression = "0";
+    parameters.trueSolExpression = "0";
+    parameters.factorDir = "none";
+    parameters.fprintError = 0;
+    parameters.stagingMB = 0;
+    parameters.mixedPrecision = 0;
+    parameters.hybridized = 0;
+    parameters.timeSteps = 0;
+    parameters.timeStep = 0.01;
+    parameters.timeTheta = 1;
+    parameters.outputEvery = 0;
+    parameters.maxNewton = 20;
+    parameters.newtonTol = 1e-10;
+    parameters.lagJacobian = 0;
+    parameters.solverStats = 0;
+    dimension = 2;
+    epsilon = 1;
+    sigma0 = 10;
+    beta0 = 1;
+}
 
 // read parameters from an input file
-Problem::Problem(int argc, char const *argv[])
+Problem::Problem(int argc, char const *argv[]): Problem()
 {
     string paramFile;
     if ( argc < 2 ) {
@@ -34,6 +100,20 @@ Problem::Problem(int argc, char const *argv[])
     fin >> parameters.meshFilename;
     getline(fin, tempStr);
     
+    // "square N [M [Z]]" instead of a filename generates the mesh of meshgen N M Z
+    std::istringstream sin(tempStr);
+    int n, m, z;
+    if (parameters.meshFilename == "square" && sin >> n) {
+        parameters.squareN = n;
+        if (sin >> m) {
+            parameters.squareM = m;
+            if (sin >> z)
+                parameters.squareZ = z;
+        }
+        parameters.meshFilename = "square_" + std::to_string(parameters.squareN) + "_"
+            + std::to_string(parameters.squareM) + "_" + std::to_string(parameters.squareZ);
+    }
+    
     fin >> dimension;
     getline(fin, tempStr);
     
@@ -79,4 +159,90 @@ Problem::Problem(int argc, char const *argv[])
     fin >> parameters.fprintTriplet;
     getline(fin, tempStr);
     
+    parameters.fprintReport = 1;
+    readOptional(fin, parameters.fprintReport);
+    readOptional(fin, parameters.nAdaptive);
+    readOptional(fin, parameters.theta);
+    readOptional(fin, parameters.adaptiveTol);
+    readOptional(fin, parameters.problemName);
+    
+    // problem "expression" is followed by the lines of f, gd and trueSol
+    if (parameters.problemName == "expression") {
+        readExpression(fin, parameters.fExpression);
+        readExpression(fin, parameters.gdExpression);
+        readExpression(fin, parameters.trueSolExpression);
+    }
+    
+    // the number of sweep cases, followed by a line "epsilon sigma0 beta0" per case
+    int nSweep = 0;
+    readOptional(fin, nSweep);
+    for (int i = 0; i < nSweep; i++) {
+        SweepCase sweepCase;
+        if (!(fin >> sweepCase.epsilon >> sweepCase.sigma0 >> sweepCase.beta0))
+            throw std::runtime_error("sweep case " + std::to_string(i + 1) + " missing in input file");
+        getline(fin, tempStr);
+        parameters.sweep.push_back(sweepCase);
+    }
+    
+    readOptional(fin, parameters.factorDir);
+    parameters.fprintError = 1;
+    readOptional(fin, parameters.fprintError);
+    readOptional(fin, parameters.stagingMB);
+    readOptional(fin, parameters.mixedPrecision);
+    readOptional(fin, parameters.hybridized);
+    readOptional(fin, parameters.timeSteps);
+    readOptional(fin, parameters.timeStep);
+    readOptional(fin, parameters.timeTheta);
+    readOptional(fin, parameters.outputEvery);
+    if (parameters.timeSteps > 0 && (parameters.timeStep <= 0 || parameters.timeTheta <= 0 || parameters.timeTheta > 1))
+        throw std::runtime_error("time stepping needs dt > 0 and 0 < theta <= 1");
+    readOptional(fin, parameters.maxNewton);
+    readOptional(fin, parameters.newtonTol);
+    readOptional(fin, parameters.lagJacobian);
+    readOptional(fin, parameters.solverStats);
+    
+}
+
+void Problem::fBatch(const double *x, const double *y, double *value, int n)
+{
+    for (int i = 0; i < n; i++)
+        value[i] = f(x[i], y[i]);
+}
+
+void Problem::gdBatch(const double *x, const double *y, double *value, int n)
+{
+    for (int i = 0; i < n; i++)
+        value[i] = gd(x[i], y[i]);
+}
+
+void Problem::trueSolBatch(const double *x, const double *y, double *value, int n)
+{
+    for (int i = 0; i < n; i++)
+        value[i] = trueSol(x[i], y[i]);
+}
+
+// one batch of the four points x +- h, y +- h around each point, h ~ cbrt(machine epsilon) times the scale
+void Problem::trueSolGradBatch(const double *x, const double *y, double *gx, double *gy, int n)
+{
+    std::vector<double> px(4 * n), py(4 * n), value(4 * n), h(n);
+    for (int i = 0; i < n; i++) {
+        h[i] = 6e-6 * std::max(1.0, std::max(std::fabs(x[i]), std::fabs(y[i])));
+        px[4 * i] = x[i] + h[i];  py[4 * i] = y[i];
+        px[4 * i + 1] = x[i] - h[i];  py[4 * i + 1] = y[i];
+        px[4 * i + 2] = x[i];  py[4 * i + 2] = y[i] + h[i];
+        px[4 * i + 3] = x[i];  py[4 * i + 3] = y[i] - h[i];
+    }
+    trueSolBatch(px.data(), py.data(), value.data(), 4 * n);
+    for (int i = 0; i < n; i++) {
+        gx[i] = (value[4 * i] - value[4 * i + 1]) / (2 * h[i]);
+        gy[i] = (value[4 * i + 2] - value[4 * i + 3]) / (2 * h[i]);
+    }
+}
+
+void Problem::reactionBatch(const double *u, double *r, double *dr, int n)
+{
+    for (int i = 0; i < n; i++) {
+        r[i] = 0;
+        dr[i] = 0;
+    }
 }
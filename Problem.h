@@ -20,21 +20,48 @@
 
 const int constNonrefined = -1;
 
+// Auto picks the fastest of UMFPACK and SuperLU by timing, see SolverTuner
 enum class SolPack {
-    UMFPACK, SuperLU, SuperLUDist, Count
+    UMFPACK, SuperLU, SuperLUDist, Auto, Count
+};
+
+// parameters of one case of a parameter sweep
+struct SweepCase {
+    double epsilon, sigma0, beta0;
 };
 
 struct paramstruct {
     std::string meshFilename; // mesh filename
+    int squareN, squareM, squareZ; // generate the square mesh of meshgen N M Z in memory if squareN > 0
     int nRefine;              // number of refinement times
-    SolPack solPack;          // solving package, UMFPACK or SuperLU
+    SolPack solPack;          // solving package, UMFPACK, SuperLU, SuperLU_DIST or Auto
     int cprintMeshInfo;       // print mesh info in console
     int cprintError;          // compute and print error
     int printResults;         // output results in console
-    int fprintResults;        // file output results, *.output
-    int fprintMA;             // file output stiff matrix in compressed column form, *.ma
+    int fprintResults;        // file output results, 1 for text *.output, 2 for binary *.bin, 3 for VTK XML *.vtu
+    int fprintMA;             // file output stiff matrix, 1 for text compressed column *.ma, 2 for Matrix Market *.mtx, 3 for binary compressed column *.csc
     int fprintRH;             // file output righ-hand side matrix, *.rh
     int fprintTriplet;        // file output stiff matrix in triplet form, *.triplet
+    int fprintReport;         // file output run report in JSON, *.report.json
+    int nAdaptive;            // number of adaptive refinement cycles
+    double theta;             // Doerfler marking parameter of adaptive refinement
+    double adaptiveTol;       // stop adaptive refinement once the error estimate is below
+    std::string problemName;  // built-in problem, see createProblem
+    std::string fExpression, gdExpression, trueSolExpression; // f, gd and trueSol of problem "expression"
+    std::vector<SweepCase> sweep; // solve for each of these parameters on the same mesh
+    std::string factorDir;    // directory to save numeric factorizations to and load them from, "none" for neither
+    int fprintError;          // file output of the error at the vertices of each element, *.err
+    long long stagingMB;      // out-of-core assembly staging the matrix on disk within this memory budget in MB, 0 in memory
+    int mixedPrecision;       // SuperLU factors in single precision with iterative refinement in double
+    int hybridized;           // hybridized DG with the traces on the edges as global unknowns instead of SIPG, tri only
+    int timeSteps;            // time steps of u_t - Laplace u = f from u = 0, 0 for the steady problem
+    double timeStep;          // dt
+    double timeTheta;         // theta of the theta-scheme, 1 for backward Euler and 0.5 for Crank-Nicolson
+    int outputEvery;          // file output of the solution every this many time steps, 0 for none
+    int maxNewton;            // Newton iterations for a problem with a reaction term
+    double newtonTol;         // stop once the residual is below this times the initial residual
+    int lagJacobian;          // reuse a factored Jacobian up to this many times while the residual at least halves
+    int solverStats;          // print the statistics of the linear solver after each factorization
 };
 
 class Problem {
@@ -45,7 +72,9 @@ public:
     double sigma0;
     double beta0;
     
+    Problem();
     Problem(int argc, char const *argv[]);
+    virtual ~Problem() {}
     
     virtual double f(double x, double y) = 0;
     
@@ -60,6 +89,17 @@ public:
         return 0;
     }
     
+    // value[i] = f(x[i], y[i]) for i < n, override to evaluate expensive coefficients vectorized
+    virtual void fBatch(const double *x, const double *y, double *value, int n);
+    virtual void gdBatch(const double *x, const double *y, double *value, int n);
+    virtual void trueSolBatch(const double *x, const double *y, double *value, int n);
+    // gradient of the true solution, by central differences of trueSolBatch unless overridden
+    virtual void trueSolGradBatch(const double *x, const double *y, double *gx, double *gy, int n);
+    
+    // the reaction term of -\Delta u + r(u) = f, solved by Newton's method if present;
+    // r[i] = r(u[i]) and dr[i] = r'(u[i]) for i < n
+    virtual bool hasReaction() { return false; }
+    virtual void reactionBatch(const double *u, double *r, double *dr, int n);
 };
 
 #endif /* defined(__tri__Problem__) */
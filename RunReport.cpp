@@ -0,0 +1,118 @@
+//
+//  RunReport.cpp
+//  tri
+//
+
+#include "RunReport.h"
+#include <fstream>
+#include <iostream>
+#include <cmath>
+#include <limits>
+#include <sys/resource.h>
+
+double RunReport::phaseTime[constPhaseCount] = {};
+long RunReport::phaseCalls[constPhaseCount] = {};
+std::vector< std::pair<std::string, double> > RunReport::values;
+
+const char *RunReport::phaseName(Phase phase)
+{
+    static const char *names[constPhaseCount] = {
+        "mesh_parsing", "mesh_generation", "connectivity", "refinement", "dof_numbering", "geometry",
+        "element_assembly", "edge_assembly", "csc_conversion",
+        "symbolic_factorization", "numeric_factorization", "solve",
+        "error_computation", "error_estimation", "output"
+    };
+    return names[static_cast<int>(phase)];
+}
+
+void RunReport::setValue(const std::string &key, double value)
+{
+    for (auto &v : values)
+        if (v.first == key) {
+            v.second = value;
+            return;
+        }
+    values.push_back(std::make_pair(key, value));
+}
+
+double RunReport::value(const std::string &key)
+{
+    for (auto &v : values)
+        if (v.first == key)
+            return v.second;
+    return 0;
+}
+
+double RunReport::peakRSS()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024.0; // bytes on OS X
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+void RunReport::clear()
+{
+    for (int i = 0; i < constPhaseCount; ++i) {
+        phaseTime[i] = 0;
+        phaseCalls[i] = 0;
+    }
+    values.clear();
+}
+
+// integers exactly, other doubles so that they read back the same, and null for nan and inf,
+// which JSON does not have
+static void writeNumber(std::ostream &out, double value)
+{
+    if (!std::isfinite(value))
+        out << "null";
+    else if (value == std::floor(value) && std::fabs(value) < 9007199254740992.0) // 2^53
+        out << (long long) value;
+    else {
+        std::streamsize precision = out.precision(std::numeric_limits<double>::max_digits10);
+        out << value;
+        out.precision(precision);
+    }
+}
+
+void RunReport::writeJSON(const std::string &filename)
+{
+    setValue("peak_rss_kb", peakRSS());
+    writeJSON(filename, 1, phaseTime, phaseTime, phaseTime);
+}
+
+void RunReport::writeJSON(const std::string &filename, int nRanks,
+                          const double *minTime, const double *maxTime, const double *avgTime)
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout) {
+        std::cout << "error opening " << filename << std::endl;
+        return;
+    }
+
+    fout << "{\n  \"ranks\": " << nRanks << ",\n  \"values\": {";
+    for (std::vector< std::pair<std::string, double> >::size_type i = 0; i < values.size(); ++i) {
+        fout << (i ? ", " : "") << "\"" << values[i].first << "\": ";
+        writeNumber(fout, values[i].second);
+    }
+    fout << "},\n  \"phases\": [\n";
+
+    for (int i = 0; i < constPhaseCount; ++i) {
+        fout << "    {\"name\": \"" << phaseName(static_cast<Phase>(i)) << "\""
+             << ", \"calls\": " << phaseCalls[i] << ", \"time\": ";
+        writeNumber(fout, phaseTime[i]);
+        fout << ", \"min\": ";
+        writeNumber(fout, minTime[i]);
+        fout << ", \"max\": ";
+        writeNumber(fout, maxTime[i]);
+        fout << ", \"avg\": ";
+        writeNumber(fout, avgTime[i]);
+        fout << "}" << (i + 1 < constPhaseCount ? ",\n" : "\n");
+    }
+    fout << "  ]\n}\n";
+
+    std::cout << "run report written to " << filename << std::endl;
+}
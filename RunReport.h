@@ -0,0 +1,82 @@
+//
+//  RunReport.h
+//  tri
+//
+//  Wall-clock timing of the phases of a run and a JSON report
+// written at the end of it. A PhaseTimer adds the wall time of its
+// scope to the phase it was created for; phases may nest, so each
+// phase time is inclusive.
+
+#ifndef __tri__RunReport__
+#define __tri__RunReport__
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <utility>
+
+enum class Phase {
+    MeshParsing, MeshGeneration, Connectivity, Refinement, DofNumbering, Geometry,
+    ElementAssembly, EdgeAssembly, CSCConversion,
+    SymbolicFactorization, NumericFactorization, Solve,
+    ErrorComputation, ErrorEstimation, Output, Count
+};
+
+const int constPhaseCount = static_cast<int>(Phase::Count);
+
+class RunReport {
+    static double phaseTime[constPhaseCount];  // accumulated wall time in seconds
+    static long phaseCalls[constPhaseCount];   // number of timed scopes
+    static std::vector< std::pair<std::string, double> > values; // run values such as dof and nnz
+
+public:
+    static const char *phaseName(Phase phase);
+
+    static void addPhase(Phase phase, double seconds)
+    {
+        phaseTime[static_cast<int>(phase)] += seconds;
+        ++phaseCalls[static_cast<int>(phase)];
+    }
+    static const double *times() { return phaseTime; }
+    static double time(Phase phase) { return phaseTime[static_cast<int>(phase)]; }
+    static long calls(Phase phase) { return phaseCalls[static_cast<int>(phase)]; }
+
+    static void setValue(const std::string &key, double value); // add or overwrite a run value
+    static double value(const std::string &key); // 0 if not set
+    static double peakRSS(); // peak resident set size of this process in KB
+    static void clear();
+
+    // write the report of a single process to filename
+    static void writeJSON(const std::string &filename);
+    // write the report with per-rank min/max/avg of each phase time
+    static void writeJSON(const std::string &filename, int nRanks,
+                          const double *minTime, const double *maxTime, const double *avgTime);
+};
+
+class PhaseTimer {
+    typedef std::chrono::steady_clock clock;
+
+    Phase phase;
+    clock::time_point start;
+    bool running;
+
+public:
+    explicit PhaseTimer(Phase p): phase(p), start(clock::now()), running(true) {}
+
+    double stop() // stop before the end of the scope, return the elapsed seconds
+    {
+        double seconds = std::chrono::duration<double>(clock::now() - start).count();
+        if (running)
+            RunReport::addPhase(phase, seconds);
+        running = false;
+        return seconds;
+    }
+
+    ~PhaseTimer()
+    {
+        if (running)
+            stop();
+    }
+};
+
+#endif /* defined(__tri__RunReport__) */
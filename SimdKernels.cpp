@@ -0,0 +1,238 @@
+//
+//  SimdKernels.cpp
+//  tri
+//
+
+#include "SimdKernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+// the lanes must round as the scalar code does, so no fused multiply-adds, which the avx2 and avx512f
+// targets would otherwise allow
+#ifdef __clang__
+#pragma STDC FP_CONTRACT OFF
+#else
+#pragma GCC optimize("fp-contract=off")
+#pragma GCC diagnostic ignored "-Wpsabi" // the vectors never cross a call, the kernels are inlined
+#endif
+
+#define SIMD_INLINE inline __attribute__((always_inline))
+
+void ElementLanes::resize(int count)
+{
+    n = count;
+    int padded = (count + SimdMaxLanes - 1) / SimdMaxLanes * SimdMaxLanes;
+    for (int i = 0; i < 3; i++) {
+        f[i].resize(padded);
+        b[i].resize(padded);
+        for (int j = 0; j < 2; j++)
+            grad[i][j].resize(padded);
+        for (int j = 0; j < 3; j++)
+            K[i][j].resize(padded);
+    }
+    detBE.resize(padded, 1); // the padding is divided by
+}
+
+void EdgeLanes::resize(int count)
+{
+    n = count;
+    int padded = (count + SimdMaxLanes - 1) / SimdMaxLanes * SimdMaxLanes;
+    for (int c = 0; c < 2; c++)
+        ne[c].resize(padded);
+    for (int i = 0; i < 3; i++) {
+        gradNe1[i].resize(padded);
+        for (int c = 0; c < 2; c++) {
+            f1[i][c].resize(padded);
+            f2[i][c].resize(padded);
+            grad1[i][c].resize(padded);
+            grad2[i][c].resize(padded);
+        }
+        for (int j = 0; j < 3; j++)
+            for (int m = 0; m < 4; m++)
+                M[m][i][j].resize(padded);
+    }
+    detBE1.resize(padded, 1);
+    detBE2.resize(padded, 1);
+}
+
+namespace {
+    typedef double Vec2 __attribute__((vector_size(16)));
+#if defined(__x86_64__) || defined(__i386__)
+    typedef double Vec4 __attribute__((vector_size(32)));
+    typedef double Vec8 __attribute__((vector_size(64)));
+#endif
+
+    template <class V>
+    struct Lanes {
+        static const int count = sizeof(V) / sizeof(double);
+    };
+
+    template <class V>
+    SIMD_INLINE V load(const double *p)
+    {
+        V v;
+        memcpy(&v, p, sizeof(V));
+        return v;
+    }
+
+    template <class V>
+    SIMD_INLINE void store(double *p, const V &v)
+    {
+        memcpy(p, &v, sizeof(V));
+    }
+
+    // by a load, since 0 + s would turn -0 into 0
+    template <class V>
+    SIMD_INLINE V splat(double s)
+    {
+        double a[Lanes<V>::count];
+        for (int l = 0; l < Lanes<V>::count; l++)
+            a[l] = s;
+        return load<V>(a);
+    }
+
+    // elementInteg and elementIntegRhs
+    template <class V>
+    SIMD_INLINE void elementKernel(ElementLanes &e)
+    {
+        const V two = splat<V>(2.0), six = splat<V>(6.0);
+        for (int k = 0; k < e.n; k += Lanes<V>::count) {
+            V g[3][2];
+            for (int i = 0; i < 3; i++)
+                for (int c = 0; c < 2; c++)
+                    g[i][c] = load<V>(&e.grad[i][c][k]);
+            V detBE = load<V>(&e.detBE[k]);
+            for (int i = 0; i < 3; i++)
+                for (int j = i; j < 3; j++) {
+                    V kij = (g[i][0] * g[j][0] + g[i][1] * g[j][1]) / detBE / two;
+                    store(&e.K[i][j][k], kij);
+                    store(&e.K[j][i][k], kij);
+                }
+            for (int i = 0; i < 3; i++)
+                store(&e.b[i][k], load<V>(&e.f[i][k]) * detBE / six);
+        }
+    }
+
+    // grad_ne
+    template <class V>
+    SIMD_INLINE void gradNeLanes(const V g[3][2], const V &detBE, const V &ne0, const V &ne1, V gn[3])
+    {
+        for (int i = 0; i < 3; i++)
+            gn[i] = (g[i][0] * ne0 + g[i][1] * ne1) / detBE;
+    }
+
+    // getMii, with s1 = sign1, s2eps = sign2 * eps and s3p = sign3 * penaltyOver6
+    template <class V>
+    SIMD_INLINE void miiLanes(std::vector<double> (&M)[3][3], int k, const V fa[3][2], const V fb[3][2],
+                              const V gna[3], const V gnb[3], const V &s1, const V &s2eps, const V &s3p)
+    {
+        const V two = splat<V>(2.0);
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++) {
+                V m = s1 * (fa[i][0] + fa[i][1]) * gnb[j] + s2eps * (fb[j][0] + fb[j][1]) * gna[i];
+                V penalty = two * fb[j][0] * fa[i][0] + two * fb[j][1] * fa[i][1]
+                          + fb[j][0] * fa[i][1] + fb[j][1] * fa[i][0];
+                m += s3p * penalty;
+                store(&M[i][j][k], m);
+            }
+    }
+
+    template <class V>
+    SIMD_INLINE void loadNeighbor(const std::vector<double> (&grad)[3][2], const std::vector<double> (&f)[3][2], int k,
+                                  V g[3][2], V fv[3][2])
+    {
+        for (int i = 0; i < 3; i++)
+            for (int c = 0; c < 2; c++) {
+                g[i][c] = load<V>(&grad[i][c][k]);
+                fv[i][c] = load<V>(&f[i][c][k]);
+            }
+    }
+
+    // edgeInteg of interior edges
+    template <class V>
+    SIMD_INLINE void interiorEdgeKernel(EdgeLanes &e, double eps, double penaltyOver6)
+    {
+        const V plus = splat<V>(1.0), minus = splat<V>(-1.0);
+        const V plusEps = splat<V>(eps), minusEps = splat<V>(-1.0 * eps);
+        const V plusPenalty = splat<V>(penaltyOver6), minusPenalty = splat<V>(-1.0 * penaltyOver6);
+        for (int k = 0; k < e.n; k += Lanes<V>::count) {
+            V g1[3][2], g2[3][2], f1[3][2], f2[3][2], gn1[3], gn2[3];
+            loadNeighbor(e.grad1, e.f1, k, g1, f1);
+            loadNeighbor(e.grad2, e.f2, k, g2, f2);
+            V ne0 = load<V>(&e.ne[0][k]), ne1 = load<V>(&e.ne[1][k]);
+            gradNeLanes(g1, load<V>(&e.detBE1[k]), ne0, ne1, gn1);
+            gradNeLanes(g2, load<V>(&e.detBE2[k]), ne0, ne1, gn2);
+            for (int i = 0; i < 3; i++)
+                store(&e.gradNe1[i][k], gn1[i]);
+
+            miiLanes(e.M[0], k, f1, f1, gn1, gn1, minus, plusEps, plusPenalty);
+            miiLanes(e.M[1], k, f1, f2, gn1, gn2, minus, minusEps, minusPenalty);
+            miiLanes(e.M[2], k, f2, f1, gn2, gn1, plus, plusEps, minusPenalty);
+            miiLanes(e.M[3], k, f2, f2, gn2, gn2, plus, minusEps, plusPenalty);
+        }
+    }
+
+    // the M11 of edgeInteg on boundary edges, the right-hand side is left to the caller
+    template <class V>
+    SIMD_INLINE void boundaryEdgeKernel(EdgeLanes &e, double eps, double penaltyOver6)
+    {
+        const V minus = splat<V>(-1.0), plusEps = splat<V>(eps), plusPenalty = splat<V>(penaltyOver6);
+        for (int k = 0; k < e.n; k += Lanes<V>::count) {
+            V g1[3][2], f1[3][2], gn1[3];
+            loadNeighbor(e.grad1, e.f1, k, g1, f1);
+            gradNeLanes(g1, load<V>(&e.detBE1[k]), load<V>(&e.ne[0][k]), load<V>(&e.ne[1][k]), gn1);
+            for (int i = 0; i < 3; i++)
+                store(&e.gradNe1[i][k], gn1[i]);
+            miiLanes(e.M[0], k, f1, f1, gn1, gn1, minus, plusEps, plusPenalty);
+        }
+    }
+}
+
+// the kernels for vector type V, as functions with the given attributes
+#define SIMD_KERNEL_SET(Name, V, ...) \
+    __VA_ARGS__ void Name##Elements(ElementLanes &e) { elementKernel<V>(e); } \
+    __VA_ARGS__ void Name##Interior(EdgeLanes &e, double eps, double p) { interiorEdgeKernel<V>(e, eps, p); } \
+    __VA_ARGS__ void Name##Boundary(EdgeLanes &e, double eps, double p) { boundaryEdgeKernel<V>(e, eps, p); } \
+    const SimdKernels Name##Kernels = {#Name, Lanes<V>::count, Name##Elements, Name##Interior, Name##Boundary};
+
+namespace {
+    SIMD_KERNEL_SET(scalar, double)
+    SIMD_KERNEL_SET(vec2, Vec2)
+#if defined(__x86_64__) || defined(__i386__)
+    SIMD_KERNEL_SET(avx2, Vec4, __attribute__((target("avx2"))))
+    SIMD_KERNEL_SET(avx512, Vec8, __attribute__((target("avx512f"))))
+#endif
+
+    const SimdKernels &chooseKernels()
+    {
+        const char *env = getenv("TRI_SIMD");
+        std::string wanted = env ? env : "";
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        bool hasAVX2 = __builtin_cpu_supports("avx2"), hasAVX512 = __builtin_cpu_supports("avx512f");
+        if (wanted == "avx512" || (wanted.empty() && hasAVX512)) {
+            if (!hasAVX512)
+                throw std::runtime_error("TRI_SIMD=avx512 but the processor has no AVX-512");
+            return avx512Kernels;
+        }
+        if (wanted == "avx2" || (wanted.empty() && hasAVX2)) {
+            if (!hasAVX2)
+                throw std::runtime_error("TRI_SIMD=avx2 but the processor has no AVX2");
+            return avx2Kernels;
+        }
+#endif
+        if (wanted.empty() || wanted == "vec2")
+            return vec2Kernels;
+        if (wanted == "scalar")
+            return scalarKernels;
+        throw std::runtime_error("unknown or unavailable TRI_SIMD " + wanted + ", use scalar, vec2, avx2 or avx512");
+    }
+}
+
+const SimdKernels &simdKernels()
+{
+    static const SimdKernels &kernels = chooseKernels();
+    return kernels;
+}
@@ -0,0 +1,49 @@
+//
+//  SimdKernels.h
+//  tri
+//
+//  The element and edge kernels of DGSolvingSystem on batches of
+// elements or edges, one per SIMD lane, from arrays with one entry per
+// element or edge. Each kernel is built for plain doubles, for 2 lanes
+// (SSE2 or NEON), and on x86 for 4 lanes with AVX2 and 8 lanes with
+// AVX-512; the widest the processor supports is chosen at run time, or
+// the one named by TRI_SIMD (scalar, vec2, avx2 or avx512). A lane does
+// the operations of the scalar code in the same order and without fused
+// multiply-adds, so all widths give the same bits.
+
+#ifndef __tri__SimdKernels__
+#define __tri__SimdKernels__
+
+#include <vector>
+
+// the arrays are padded to a multiple of SimdMaxLanes
+const int SimdMaxLanes = 8;
+
+struct ElementLanes {
+    int n;
+    std::vector<double> grad[3][2], detBE, f[3]; // ElementGeometry::grad, detBE and f at the vertices
+    std::vector<double> K[3][3], b[3];           // out: the stiffness and load of elementInteg and elementIntegRhs
+    void resize(int count);
+};
+
+// ne, f1 and f2 are those of EdgeGeometry, E1 and E2 the neighbors; boundary edges have no E2
+struct EdgeLanes {
+    int n;
+    std::vector<double> ne[2], f1[3][2], f2[3][2];
+    std::vector<double> grad1[3][2], detBE1, grad2[3][2], detBE2;
+    std::vector<double> gradNe1[3];  // out: grad_ne of E1
+    std::vector<double> M[4][3][3];  // out: M11, M12, M21, M22 of edgeInteg, only M11 on boundary edges
+    void resize(int count);
+};
+
+struct SimdKernels {
+    const char *name;
+    int lanes;
+    void (*elementBlocks)(ElementLanes &e);
+    void (*interiorEdgeBlocks)(EdgeLanes &e, double eps, double penaltyOver6);
+    void (*boundaryEdgeBlocks)(EdgeLanes &e, double eps, double penaltyOver6);
+};
+
+const SimdKernels &simdKernels(); // chosen on the first call
+
+#endif /* defined(__tri__SimdKernels__) */
@@ -0,0 +1,93 @@
+//
+//  SinglePrecisionLU.cpp
+//  tri
+//
+
+#include "SinglePrecisionLU.h"
+#include "../SuperLU_4.3/SRC/slu_sdefs.h"
+#include <vector>
+#include <cmath>
+#include <cfloat>
+
+struct SinglePrecisionLU::Factors {
+    int n;
+    SuperMatrix L, U;
+    int *perm_c, *perm_r;
+    SuperLUStat_t stat;
+};
+
+SinglePrecisionLU::~SinglePrecisionLU()
+{
+    if (factors == nullptr)
+        return;
+    Destroy_SuperNode_Matrix(&factors -> L);
+    Destroy_CompCol_Matrix(&factors -> U);
+    SUPERLU_FREE(factors -> perm_c);
+    SUPERLU_FREE(factors -> perm_r);
+    StatFree(&factors -> stat);
+    delete factors;
+}
+
+// sgssv factors and solves for a zero right-hand side, the factors are kept for solve
+bool SinglePrecisionLU::factor(int n, const int *Ap, const int *Ai, const double *Ax, bool naturalOrdering)
+{
+    int nnz = Ap[n];
+    std::vector<float> values(nnz), zero(n, 0.0f);
+    for (int k = 0; k < nnz; k++) {
+        if (std::fabs(Ax[k]) > FLT_MAX)
+            return false;
+        values[k] = (float) Ax[k];
+    }
+    
+    superlu_options_t options;
+    set_default_options(&options);
+    options.ColPerm = naturalOrdering ? NATURAL : COLAMD;
+    
+    SuperMatrix A, B;
+    sCreate_CompCol_Matrix(&A, n, n, nnz, values.data(), const_cast<int *>(Ai), const_cast<int *>(Ap), SLU_NC, SLU_S, SLU_GE);
+    sCreate_Dense_Matrix(&B, n, 1, zero.data(), n, SLU_DN, SLU_S, SLU_GE);
+    
+    Factors *f = new Factors;
+    f -> n = n;
+    f -> perm_c = intMalloc(n);
+    f -> perm_r = intMalloc(n);
+    StatInit(&f -> stat);
+    int info;
+    sgssv(&options, &A, f -> perm_c, f -> perm_r, &f -> L, &f -> U, &B, &f -> stat, &info);
+    Destroy_SuperMatrix_Store(&A);
+    Destroy_SuperMatrix_Store(&B);
+    
+    factors = f;
+    if (info != 0) { // L and U are only allocated for info <= n
+        if (info > n) {
+            SUPERLU_FREE(f -> perm_c);
+            SUPERLU_FREE(f -> perm_r);
+            StatFree(&f -> stat);
+            delete f;
+            factors = nullptr;
+        }
+        return false;
+    }
+    return true;
+}
+
+void SinglePrecisionLU::solve(float *b) const
+{
+    SuperMatrix B;
+    sCreate_Dense_Matrix(&B, factors -> n, 1, b, factors -> n, SLU_DN, SLU_S, SLU_GE);
+    int info;
+    sgstrs(NOTRANS, &factors -> L, &factors -> U, factors -> perm_c, factors -> perm_r, &B, &factors -> stat, &info);
+    Destroy_SuperMatrix_Store(&B);
+}
+
+long long SinglePrecisionLU::factorNonzeros() const
+{
+    return (long long) ((SCformat *) factors -> L.Store) -> nnz + ((NCformat *) factors -> U.Store) -> nnz;
+}
+
+double SinglePrecisionLU::factorBytes() const
+{
+    mem_usage_t mem;
+    sQuerySpace(&factors -> L, &factors -> U, &mem);
+    return mem.for_lu;
+}
@@ -0,0 +1,32 @@
+//
+//  SinglePrecisionLU.h
+//  tri
+//
+//  SuperLU factorization of a single precision copy of a CSC matrix, kept
+// for solves. It is apart from SuperLUSolver as slu_sdefs.h and slu_ddefs.h
+// cannot be included together.
+
+#ifndef __tri__SinglePrecisionLU__
+#define __tri__SinglePrecisionLU__
+
+class SinglePrecisionLU {
+public:
+    SinglePrecisionLU(): factors(nullptr) {}
+    ~SinglePrecisionLU();
+    
+    // false if a value does not fit in a float or the matrix is singular in single precision
+    bool factor(int n, const int *Ap, const int *Ai, const double *Ax, bool naturalOrdering);
+    void solve(float *b) const; // overwrite b by the solution
+    
+    long long factorNonzeros() const; // of L and U
+    double factorBytes() const;
+    
+private:
+    struct Factors;
+    Factors *factors;
+    
+    SinglePrecisionLU(const SinglePrecisionLU &);
+    SinglePrecisionLU &operator=(const SinglePrecisionLU &);
+};
+
+#endif /* defined(__tri__SinglePrecisionLU__) */
@@ -0,0 +1,174 @@
+//
+//  SolutionWriter.cpp
+//  tri
+//
+
+#include "SolutionWriter.h"
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
+
+using std::vector;
+using std::string;
+
+void SolutionWriter::start(const Mesh &mesh, const vector<double> &x, const string &baseName, int format)
+{
+    wait();
+    thread = std::thread([this, &mesh, &x, baseName, format]() {
+        std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+        try {
+            gather(mesh, x);
+            if (format == Binary)
+                writeBinary(baseName + ".bin");
+            else if (format == VTU)
+                writeVTU(baseName + ".vtu");
+            else
+                writeText(baseName + ".output");
+        } catch (...) {
+            error = std::current_exception();
+        }
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    });
+}
+
+void SolutionWriter::wait()
+{
+    if (!thread.joinable())
+        return;
+    thread.join();
+    RunReport::addPhase(Phase::Output, seconds);
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+SolutionWriter::~SolutionWriter()
+{
+    if (thread.joinable())
+        thread.join();
+}
+
+void SolutionWriter::gather(const Mesh &mesh, const vector<double> &x)
+{
+    xy.clear();
+    connectivity.clear();
+    value.clear();
+    vector<int> local(mesh.vertex.size(), -1); // 0-based index in xy of each mesh vertex
+    for (const Element &ele : mesh.element) {
+        if (ele.reftype != constNonrefined)
+            continue;
+        for (int k = 0; k < 3; k++) {
+            int ver = ele.vertex[k];
+            if (local[ver - 1] < 0) {
+                local[ver - 1] = xy.size() / 2;
+                xy.push_back(mesh.vertex[ver - 1].x);
+                xy.push_back(mesh.vertex[ver - 1].y);
+            }
+            connectivity.push_back(local[ver - 1]);
+            value.push_back(x[ele.dofIndex + k]);
+        }
+    }
+}
+
+void SolutionWriter::writeText(const string &filename)
+{
+    std::ofstream fout(filename.c_str());
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    for (vector<int>::size_type k = 0; k < connectivity.size(); k++)
+        fout << xy[2 * connectivity[k]] << " " << xy[2 * connectivity[k] + 1] << " " << value[k] << '\n';
+}
+
+void SolutionWriter::writeBinary(const string &filename)
+{
+    std::ofstream fout(filename.c_str(), std::ios::binary);
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+    int32_t nv = xy.size() / 2, ne = connectivity.size() / 3;
+    fout.write("TRISOL1\n", 8);
+    fout.write(reinterpret_cast<const char *>(&nv), sizeof(nv));
+    fout.write(reinterpret_cast<const char *>(&ne), sizeof(ne));
+    fout.write(reinterpret_cast<const char *>(xy.data()), xy.size() * sizeof(double));
+    vector<int32_t> conn(connectivity.begin(), connectivity.end());
+    fout.write(reinterpret_cast<const char *>(conn.data()), conn.size() * sizeof(int32_t));
+    fout.write(reinterpret_cast<const char *>(value.data()), value.size() * sizeof(double));
+    if (!fout)
+        throw std::runtime_error("error writing " + filename);
+}
+
+namespace {
+    bool isLittleEndian()
+    {
+        const uint16_t one = 1;
+        return *reinterpret_cast<const uint8_t *>(&one) == 1;
+    }
+    
+    // a block of appended data, preceded by its size in bytes as header_type UInt64
+    template <typename T>
+    void appendBlock(std::ofstream &fout, const vector<T> &data)
+    {
+        uint64_t bytes = data.size() * sizeof(T);
+        fout.write(reinterpret_cast<const char *>(&bytes), sizeof(bytes));
+        fout.write(reinterpret_cast<const char *>(data.data()), bytes);
+    }
+}
+
+void SolutionWriter::writeVTU(const string &filename)
+{
+    std::ofstream fout(filename.c_str(), std::ios::binary);
+    if (!fout)
+        throw std::runtime_error("error opening " + filename);
+
+    // the vertices of each element as its own points, z = 0
+    int ne = connectivity.size() / 3, np = connectivity.size();
+    vector<double> points(3 * np);
+    vector<int32_t> cells(np), offsets(ne);
+    vector<uint8_t> types(ne, 5); // VTK_TRIANGLE
+    for (int k = 0; k < np; k++) {
+        points[3 * k] = xy[2 * connectivity[k]];
+        points[3 * k + 1] = xy[2 * connectivity[k] + 1];
+        points[3 * k + 2] = 0;
+        cells[k] = k;
+    }
+    for (int i = 0; i < ne; i++)
+        offsets[i] = 3 * (i + 1);
+
+    // byte offsets of the blocks in the appended data
+    const uint64_t header = sizeof(uint64_t);
+    uint64_t offPoints = 0;
+    uint64_t offCells = offPoints + header + points.size() * sizeof(double);
+    uint64_t offOffsets = offCells + header + cells.size() * sizeof(int32_t);
+    uint64_t offTypes = offOffsets + header + offsets.size() * sizeof(int32_t);
+    uint64_t offValue = offTypes + header + types.size() * sizeof(uint8_t);
+
+    fout << "<?xml version=\"1.0\"?>\n"
+         << "<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" byte_order=\"" << (isLittleEndian() ? "LittleEndian" : "BigEndian")
+         << "\" header_type=\"UInt64\">\n"
+         << "<UnstructuredGrid>\n"
+         << "<Piece NumberOfPoints=\"" << np << "\" NumberOfCells=\"" << ne << "\">\n"
+         << "<PointData Scalars=\"solution\">\n"
+         << "<DataArray type=\"Float64\" Name=\"solution\" format=\"appended\" offset=\"" << offValue << "\"/>\n"
+         << "</PointData>\n"
+         << "<Points>\n"
+         << "<DataArray type=\"Float64\" NumberOfComponents=\"3\" format=\"appended\" offset=\"" << offPoints << "\"/>\n"
+         << "</Points>\n"
+         << "<Cells>\n"
+         << "<DataArray type=\"Int32\" Name=\"connectivity\" format=\"appended\" offset=\"" << offCells << "\"/>\n"
+         << "<DataArray type=\"Int32\" Name=\"offsets\" format=\"appended\" offset=\"" << offOffsets << "\"/>\n"
+         << "<DataArray type=\"UInt8\" Name=\"types\" format=\"appended\" offset=\"" << offTypes << "\"/>\n"
+         << "</Cells>\n"
+         << "</Piece>\n"
+         << "</UnstructuredGrid>\n"
+         << "<AppendedData encoding=\"raw\">\n_";
+    appendBlock(fout, points);
+    appendBlock(fout, cells);
+    appendBlock(fout, offsets);
+    appendBlock(fout, types);
+    appendBlock(fout, value);
+    fout << "\n</AppendedData>\n</VTKFile>\n";
+    if (!fout)
+        throw std::runtime_error("error writing " + filename);
+}
@@ -0,0 +1,53 @@
+//
+//  SolutionWriter.h
+//  tri
+//
+//  File output of the solution on the leaf elements, written in a
+// background thread so that it overlaps with the error computation.
+// Formats, by the value of fprintResults:
+//  1  *.output, text "x y value" for each vertex of each element
+//  2  *.bin, binary in native byte order: the 8 bytes "TRISOL1\n",
+//     int32 number of vertices nv and of elements ne, double x y of
+//     each vertex, int32 0-based vertex indices of each element and
+//     double values at the three vertices of each element
+//  3  *.vtu, VTK XML unstructured grid with raw appended data; the
+//     points are repeated for each element so that the discontinuous
+//     solution is point data
+
+#ifndef __tri__SolutionWriter__
+#define __tri__SolutionWriter__
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <exception>
+#include "Mesh.h"
+
+class SolutionWriter {
+public:
+    enum Format { Text = 1, Binary = 2, VTU = 3 };
+
+    SolutionWriter(): seconds(0) {}
+
+    // start writing the solution x of the leaf elements; mesh and x must stay unchanged until wait
+    void start(const Mesh &mesh, const std::vector<double> &x, const std::string &baseName, int format);
+    void wait(); // for the writing to finish, rethrows its error and adds its time to the output phase
+    ~SolutionWriter();
+
+private:
+    std::thread thread;
+    std::exception_ptr error;
+    double seconds;
+
+    // each vertex once, three vertices and values per element
+    std::vector<double> xy;
+    std::vector<int> connectivity;
+    std::vector<double> value;
+
+    void gather(const Mesh &mesh, const std::vector<double> &x);
+    void writeText(const std::string &filename);
+    void writeBinary(const std::string &filename);
+    void writeVTU(const std::string &filename);
+};
+
+#endif /* defined(__tri__SolutionWriter__) */
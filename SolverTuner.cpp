@@ -0,0 +1,75 @@
+//
+//  SolverTuner.cpp
+//  tri
+//
+
+#include "SolverTuner.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cctype>
+#include <cmath>
+
+using std::string;
+
+SolverTuner::SolverTuner(const string &meshFilename)
+{
+    // numbers in the name, not in the directory, are what varies within a family
+    string::size_type slash = meshFilename.rfind('/');
+    string::size_type start = slash == string::npos ? 0 : slash + 1;
+    filename = meshFilename.substr(0, start);
+    for (string::size_type i = start; i < meshFilename.size(); i++) {
+        if (!isdigit((unsigned char) meshFilename[i]))
+            filename += meshFilename[i];
+        else if (i == start || !isdigit((unsigned char) meshFilename[i - 1]))
+            filename += 'N';
+    }
+    filename += ".autotune";
+    
+    std::ifstream fin(filename.c_str());
+    string line;
+    while (getline(fin, line)) {
+        std::istringstream sin(line);
+        Decision d;
+        if (sin >> d.dof >> d.nnz >> d.choice && d.dof > 0 && d.choice >= 0 && d.choice < static_cast<int>(SolverChoice::Count))
+            decisions.push_back(d);
+    }
+}
+
+bool SolverTuner::lookup(int dof, SolverChoice &choice) const
+{
+    double closest = std::log(2.0) + 1e-12;
+    bool found = false;
+    for (const Decision &d : decisions) {
+        double distance = std::fabs(std::log((double) dof / d.dof));
+        if (distance <= closest) {
+            closest = distance;
+            choice = static_cast<SolverChoice>(d.choice);
+            found = true;
+        }
+    }
+    return found;
+}
+
+void SolverTuner::record(int dof, long long nnz, SolverChoice choice, const std::vector<double> &seconds)
+{
+    Decision d = {dof, nnz, static_cast<int>(choice)};
+    decisions.push_back(d);
+    std::ofstream fout(filename.c_str(), std::ios::app);
+    fout << dof << " " << nnz << " " << d.choice;
+    for (double t : seconds)
+        fout << " " << t;
+    fout << "\n";
+    if (!fout)
+        std::cout << "could not write the solver decision to " << filename << std::endl;
+}
+
+const char *SolverTuner::name(SolverChoice choice)
+{
+    switch (choice) {
+        case SolverChoice::UMFPACK: return "UMFPACK";
+        case SolverChoice::SuperLUNatural: return "SuperLU natural ordering";
+        case SolverChoice::SuperLUCOLAMD: return "SuperLU COLAMD ordering";
+        default: return "unknown";
+    }
+}
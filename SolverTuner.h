@@ -0,0 +1,42 @@
+//
+//  SolverTuner.h
+//  tri
+//
+//  Automatic choice of the sparse direct solver by the measured time of one
+// solve with each candidate. Decisions are cached per mesh family, the mesh
+// filename with its numbers replaced by N, in family.autotune with a line
+// "dof nnz choice seconds of each candidate" per probed size. A run takes
+// the decision of the closest cached size within a factor 2 of its dof.
+
+#ifndef __tri__SolverTuner__
+#define __tri__SolverTuner__
+
+#include <string>
+#include <vector>
+
+// the candidates, solver and column ordering
+enum class SolverChoice {
+    UMFPACK, SuperLUNatural, SuperLUCOLAMD, Count
+};
+
+class SolverTuner {
+public:
+    explicit SolverTuner(const std::string &meshFilename); // reads the cache of the family of the mesh
+    
+    bool lookup(int dof, SolverChoice &choice) const; // the cached decision for a similar size
+    void record(int dof, long long nnz, SolverChoice choice, const std::vector<double> &seconds);
+    
+    const std::string &cacheFile() const { return filename; }
+    static const char *name(SolverChoice choice);
+    
+private:
+    struct Decision {
+        int dof;
+        long long nnz;
+        int choice;
+    };
+    std::string filename;
+    std::vector<Decision> decisions;
+};
+
+#endif /* defined(__tri__SolverTuner__) */
@@ -0,0 +1,644 @@
+//
+//  SquareMesh.cpp
+//  tri
+//
+
+#include "SquareMesh.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+using std::vector;
+using std::string;
+
+static const double pi = 3.14159;
+static const double Width = pi;
+static const double Height = pi;
+static const double Left = 0.5 * pi;
+static const double Bottom = 0;
+
+// buffered output with its own number formatting, much faster than ofstream with endl
+class OutputFile {
+    FILE *file;
+    vector<char> buffer;
+    size_t pos;
+
+    void reserve(size_t n)
+    {
+        if (pos + n > buffer.size()) {
+            fwrite(buffer.data(), 1, pos, file);
+            pos = 0;
+        }
+    }
+
+public:
+    OutputFile(const string &name): buffer(1 << 20), pos(0)
+    {
+        file = fopen(name.c_str(), "w");
+        if (!file)
+            throw std::runtime_error("error opening " + name);
+    }
+    ~OutputFile()
+    {
+        fwrite(buffer.data(), 1, pos, file);
+        fclose(file);
+    }
+
+    OutputFile &operator<<(const char *s)
+    {
+        size_t n = strlen(s);
+        reserve(n);
+        memcpy(&buffer[pos], s, n);
+        pos += n;
+        return *this;
+    }
+    OutputFile &operator<<(char c)
+    {
+        reserve(1);
+        buffer[pos++] = c;
+        return *this;
+    }
+    OutputFile &operator<<(long long v)
+    {
+        char digits[24];
+        int n = 0;
+        unsigned long long u = v < 0 ? -v : v;
+        do {
+            digits[n++] = '0' + u % 10;
+            u /= 10;
+        } while (u);
+        reserve(n + 1);
+        if (v < 0)
+            buffer[pos++] = '-';
+        while (n)
+            buffer[pos++] = digits[--n];
+        return *this;
+    }
+    OutputFile &operator<<(int v) { return *this << (long long) v; }
+    OutputFile &operator<<(size_t v) { return *this << (long long) v; }
+    OutputFile &operator<<(double v) // as ostream does by default
+    {
+        reserve(32);
+        pos += snprintf(&buffer[pos], 32, "%g", v);
+        return *this;
+    }
+};
+
+SquareMeshGenerator::SquareMeshGenerator(int n, int m, int z): N(n), M(m), Z(z), nRefine(0)
+{
+    if (N < 3 || M < 3 || Z < 3)
+        throw std::runtime_error("square mesh: N, M, Z cannot be less than 3");
+    if (M % 2 == 0 || Z % 2 == 0)
+        throw std::runtime_error("square mesh: M and Z must be odd");
+
+    hx = Width / (N - 1);
+    hy = Height / (N - 1);
+    mx = hx / (M - 1);
+    my = hy / (M - 1);
+    zx = mx / (Z - 1);
+    zy = my / (Z - 1);
+    fx = hx / ((M - 1) * (Z - 1));
+    fy = hy / ((M - 1) * (Z - 1));
+    nLattice = (long long) (N - 1) * (M - 1) * (Z - 1) + 1;
+}
+
+SquareMeshGenerator::Node SquareMeshGenerator::coarseNode(int index) const
+{
+    int i = (index - 1) / N + 1, j = (index - 1) % N + 1;
+    Node node = {index, Left + (j - 1) * hx, Bottom + (i - 1) * hy,
+                 (j == 1 || j == N || i == 1 || i == N) ? 1 : 0};
+    return node;
+}
+
+// coarse edges are numbered rows first, then columns, then diagonals
+SquareMeshGenerator::Edge SquareMeshGenerator::coarseEdge(int index) const
+{
+    int k = index - 1;
+    if (k < N * (N - 1)) {
+        int i = k / (N - 1) + 1, j = k % (N - 1) + 1;
+        Edge edge = {index, (i - 1) * N + j, (i - 1) * N + j + 1, (i == 1 || i == N) ? 1 : 0, 0};
+        return edge;
+    }
+    k -= N * (N - 1);
+    if (k < N * (N - 1)) {
+        int j = k / (N - 1) + 1, i = k % (N - 1) + 1;
+        Edge edge = {index, (i - 1) * N + j, i * N + j, (j == 1 || j == N) ? 1 : 0, 0};
+        return edge;
+    }
+    k -= N * (N - 1);
+    int i = k / (N - 1) + 1, j = k % (N - 1) + 1;
+    Edge edge = {index, (i - 1) * N + j, i * N + j + 1, 0, 0};
+    return edge;
+}
+
+// square (i, j) holds elements 2k - 1 and 2k, k = (N - 1)(i - 1) + j
+SquareMeshGenerator::Element SquareMeshGenerator::coarseElement(int index) const
+{
+    int k = (index - 1) / 2;
+    int i = k / (N - 1) + 1, j = k % (N - 1) + 1;
+    Element element;
+    if (index % 2 == 1)
+        element = {index, (i - 1) * N + j, i * N + j + 1, i * N + j, 0};
+    else
+        element = {index, (i - 1) * N + j, (i - 1) * N + j + 1, i * N + j + 1, 0};
+    return element;
+}
+
+int SquareMeshGenerator::numNode() const
+{
+    return numCoarseNode() + node[0].size() + node[1].size();
+}
+
+int SquareMeshGenerator::numEdge() const
+{
+    return numCoarseEdge() + edge[0].size() + edge[1].size();
+}
+
+int SquareMeshGenerator::numElement() const
+{
+    return numCoarseElement() + element[0].size() + element[1].size();
+}
+
+SquareMeshGenerator::Edge SquareMeshGenerator::edgeAt(int index) const
+{
+    if (index <= numCoarseEdge())
+        return coarseEdge(index);
+    index -= numCoarseEdge() + 1;
+    if (index < (int) edge[0].size())
+        return edge[0][index];
+    return edge[1][index - edge[0].size()];
+}
+
+// nodes on the coarse lattice follow from N, the others are looked up
+int SquareMeshGenerator::findNode(double x, double y) const
+{
+    long long ix = llround((x - Left) / fx), iy = llround((y - Bottom) / fy);
+    if (ix < 0 || iy < 0 || ix >= nLattice || iy >= nLattice)
+        return 0;
+    if (fabs(Left + ix * fx - x) >= 0.0001 || fabs(Bottom + iy * fy - y) >= 0.0001)
+        return 0;
+
+    int step = (M - 1) * (Z - 1);
+    if (ix % step == 0 && iy % step == 0)
+        return (iy / step) * N + ix / step + 1;
+
+    auto it = nodeIndex.find(iy * nLattice + ix);
+    return it == nodeIndex.end() ? 0 : it -> second;
+}
+
+int SquareMeshGenerator::findEdge(int v1, int v2) const
+{
+    if (v1 <= N * N && v2 <= N * N) {
+        int i = (v1 - 1) / N + 1, j = (v1 - 1) % N + 1;
+        if (v2 == v1 + 1 && j < N)
+            return (i - 1) * (N - 1) + j;
+        if (v2 == v1 + N)
+            return N * (N - 1) + i + (j - 1) * (N - 1);
+        if (v2 == v1 + N + 1 && j < N)
+            return 2 * N * (N - 1) + (i - 1) * (N - 1) + j;
+    }
+
+    auto it = edgeIndex.find(((long long) v1 << 32) | v2);
+    return it == edgeIndex.end() ? 0 : it -> second;
+}
+
+int SquareMeshGenerator::findElement(int v1, int v2, int v3) const
+{
+    auto it = elementIndex.find(VertexTriple {v1, v2, v3});
+    return it == elementIndex.end() ? 0 : it -> second;
+}
+
+void SquareMeshGenerator::pushNode(double x, double y, int bctype)
+{
+    int index = numNode() + 1;
+    node[nRefine].push_back(Node {index, x, y, bctype});
+    long long ix = llround((x - Left) / fx), iy = llround((y - Bottom) / fy);
+    nodeIndex.emplace(iy * nLattice + ix, index);
+}
+
+void SquareMeshGenerator::pushEdge(int v1, int v2, int bctype, int parent)
+{
+    int index = numEdge() + 1;
+    edge[nRefine].push_back(Edge {index, v1, v2, bctype, parent});
+    edgeIndex.emplace(((long long) v1 << 32) | v2, index);
+}
+
+void SquareMeshGenerator::pushElement(int v1, int v2, int v3, int parent)
+{
+    int index = numElement() + 1;
+    element[nRefine].push_back(Element {index, v1, v2, v3, parent});
+    elementIndex.emplace(VertexTriple {v1, v2, v3}, index);
+}
+
+void SquareMeshGenerator::refine()
+{
+    if (nRefine >= maxRefine)
+        throw std::runtime_error("square mesh: at most 2 refinement levels");
+
+    if (nRefine == 0) {
+        genRefineRoundNode();
+
+        genRefineRoundEdge(1, 1, 1, 1, 1, 1);
+        for (int j = 2; j <= N - 1; j++)
+            genRefineRoundEdge(j, 1, 1, 1, 1, 0);
+        for (int i = 2; i <= N - 2; i++) {
+            genRefineRoundEdge(1, i, 0, 1, 1, 1);
+            genRefineRoundEdge(N - 1, i, 0, 1, 1, 1);
+        }
+        genRefineRoundEdge(1, N - 1, 0, 1, 1, 1);
+        for (int j = 2; j <= N - 2; j++)
+            genRefineRoundEdge(j, N - 1, 1, 1, 1, 0);
+        genRefineRoundEdge(N - 1, N - 1, 0, 1, 1, 0);
+
+        genRefineRoundElement();
+    } else {
+        int K = (N - 1) * (M - 1); // squares per side after level 0
+        genRefineRoundNode1();
+
+        genRefineRoundEdge1(1, 1, 1, 1, 1, 1);
+        for (int j = 2; j <= K; j++)
+            genRefineRoundEdge1(j, 1, 1, 1, 1, 0);
+        for (int i = 2; i <= K - 1; i++) {
+            genRefineRoundEdge1(1, i, 0, 1, 1, 1);
+            genRefineRoundEdge1(K, i, 0, 1, 1, 1);
+        }
+        genRefineRoundEdge1(1, K, 0, 1, 1, 1);
+        for (int j = 2; j <= K - 1; j++)
+            genRefineRoundEdge1(j, K, 1, 1, 1, 0);
+        genRefineRoundEdge1(K, K, 0, 1, 1, 0);
+
+        genRefineRoundElement1();
+    }
+    ++nRefine;
+}
+
+void SquareMeshGenerator::genRefineRoundNode()
+{
+    // new node on row edge
+    for (int i = 1; i <= N; i++) {
+        if (i > 2 && i < N - 1) {
+            for (int j = 2; j <= M - 1; j ++)
+                pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * hy, 0);
+            for (int j = 2; j <= M - 1; j ++)
+                pushNode(Left + Width - hx + (j - 1) * mx, Bottom + (i - 1) * hy, 0);
+        } else {
+            for (int j = 2; j <= (M - 1) * (N - 1); j++) {
+                if ((j - 1) % (M - 1) == 0) continue;
+                if (i == 1 || i == N)
+                    pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * hy, 1);
+                else
+                    pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * hy, 0);
+            }
+        }
+    }
+
+    // new node on col edge
+    for (int j = 1; j <= N; j++) {
+        if (j > 2 && j < N - 1) {
+            for (int i = 2; i <= M - 1; i++)
+                pushNode(Left + (j - 1) * hx, Bottom + (i - 1) * my, 0);
+            for (int i = 2; i <= M - 1; i++)
+                pushNode(Left + (j - 1) * hx, Bottom + Height - hy + (i - 1) * my, 0);
+        } else {
+            for (int i = 2; i <= (M - 1) * (N - 1); i++) {
+                if ((i - 1) % (M - 1) == 0) continue;
+                if (j == 1 || j == N)
+                    pushNode(Left + (j - 1) * hx, Bottom + (i - 1) * my, 1);
+                else
+                    pushNode(Left + (j - 1) * hx, Bottom + (i - 1) * my, 0);
+            }
+        }
+    }
+
+    // inside each square
+    for (int i = 1; i <= N - 1; i++)
+        for (int j = 1; j <= N - 1; j++) {
+            if (i > 1 && i < N - 1 && j > 1 && j < N - 1 ) continue;
+            double startx = Left + (j - 1) * hx;
+            double starty = Bottom + (i - 1) * hy;
+            for (int mi = 2; mi <= M - 1; mi++)
+                for (int mj = 2; mj <= M - 1; mj++)
+                    pushNode(startx + (mj - 1) * mx, starty + (mi - 1) * my, 0);
+        }
+}
+
+// split edge indexEdge at the m - 2 consecutive nodes from indexNode on
+void SquareMeshGenerator::genSquareEdge(int indexEdge, int indexNode, int m)
+{
+    Edge parent = edgeAt(indexEdge);
+
+    pushEdge(parent.v1, indexNode, parent.bctype, indexEdge);
+    for (int i = 0; i < m - 3; i++)
+        pushEdge(indexNode + i, indexNode + i + 1, parent.bctype, indexEdge);
+    pushEdge(indexNode + m - 3, parent.v2, parent.bctype, indexEdge);
+}
+
+void SquareMeshGenerator::genRefineRoundEdge(int j, int i, int flagBottom, int flagRight, int flagTop, int flagLeft)
+{
+    int indexEdgeBottom = (i - 1) * (N - 1) + j;
+    int indexEdgeTop = i * (N - 1) + j;
+    int indexEdgeLeft = N * (N - 1) + i + (j - 1) * (N - 1);
+    int indexEdgeRight = N * (N - 1) + i + j * (N - 1);
+    int indexEdgeDiag = 2 * N * (N - 1) + (i - 1) * (N - 1) + j;
+
+    int indexNodeBottom = findNode(Left + (j - 1) * hx + mx, Bottom + (i - 1) * hy);
+    int indexNodeTop = findNode(Left + (j - 1) * hx + mx, Bottom + i * hy);
+    int indexNodeLeft = findNode(Left + (j - 1) * hx, Bottom + (i - 1) * hy + my);
+    int indexNodeRight = findNode(Left + j * hx, Bottom + (i - 1) * hy + my);
+
+    if (flagBottom)
+        genSquareEdge(indexEdgeBottom, indexNodeBottom, M);
+
+    if (flagTop)
+        genSquareEdge(indexEdgeTop, indexNodeTop, M);
+
+    if (flagLeft)
+        genSquareEdge(indexEdgeLeft, indexNodeLeft, M);
+
+    if (flagRight)
+        genSquareEdge(indexEdgeRight, indexNodeRight, M);
+
+    double startx = Left + (j - 1) * hx;
+    double starty = Bottom + (i - 1) * hy;
+    // interior row
+    for (int ii = 2; ii <= M - 1; ii++) {
+        for (int jj = 1; jj <= M - 1; jj++) {
+            int left = findNode(startx + (jj - 1) * mx, starty + (ii - 1) * my);
+            int right = findNode(startx + jj * mx, starty + (ii - 1) * my);
+            pushEdge(left, right, 0, 0);
+        }
+    }
+
+    // interior col
+    for (int jj = 2; jj <= M - 1; jj++) {
+        for (int ii = 1; ii <= M - 1; ii++) {
+            int bottom = findNode(startx + (jj - 1) * mx, starty + (ii - 1) * my);
+            int top = findNode(startx + (jj - 1) * mx, starty + ii * my);
+            pushEdge(bottom, top, 0, 0);
+        }
+    }
+
+    // diag
+    for (int ii = 1; ii <= M - 1; ii++) {
+        for (int jj = 1; jj <= M - 1; jj++) {
+            int v1 = findNode(startx + (jj - 1) * mx, starty + (ii - 1) * my);
+            int v2 = findNode(startx + jj * mx, starty + ii * my);
+            if (ii == jj)
+                pushEdge(v1, v2, 0, indexEdgeDiag);
+            else
+                pushEdge(v1, v2, 0, 0);
+        }
+    }
+}
+
+void SquareMeshGenerator::genRefineRoundElement()
+{
+    for (int i = 1; i <= N - 1; i++)
+        for (int j = 1; j <= N - 1; j++) {
+            if (i > 1 && i < N - 1 && j > 1 && j < N - 1 ) continue;
+            double startx = Left + (j - 1) * hx;
+            double starty = Bottom + (i - 1) * hy;
+            int element1 = (2 * N - 2) * (i - 1) + 2 * j - 1;
+            int element2 = element1 + 1;
+            for (int ii = 1; ii <= M - 1; ii++)
+                for (int jj = 1; jj <= M - 1; jj ++) {
+                    int v1 = findNode(startx + (jj - 1) * mx, starty + (ii - 1) * my);
+                    int v2 = findNode(startx + jj * mx, starty + (ii - 1) * my);
+                    int v3 = findNode(startx + (jj - 1) * mx, starty + ii * my);
+                    int v4 = findNode(startx + jj * mx, starty + ii * my);
+
+                    if (ii >= jj)
+                        pushElement(v1, v4, v3, element1);
+                    else
+                        pushElement(v1, v4, v3, element2);
+
+                    if (ii <= jj)
+                        pushElement(v1, v2, v4, element2);
+                    else
+                        pushElement(v1, v2, v4, element1);
+                }
+        }
+}
+
+void SquareMeshGenerator::genRefineRoundNode1()
+{
+    // new node on row edge
+    for (int i = 1; i <= (N - 1) * (M - 1) + 1; i++) {
+        if (i > 2 && i < (N - 1) * (M - 1) ) {
+            for (int j = 2; j <= Z - 1; j ++)
+                pushNode(Left + (j - 1) * zx, Bottom + (i - 1) * my, 0);
+            for (int j = 2; j <= Z - 1; j ++)
+                pushNode(Left + Width - mx + (j - 1) * zx, Bottom + (i - 1) * my, 0);
+        } else {
+            for (int j = 2; j <= (M - 1) * (N - 1) * (Z - 1); j++) {
+                if ((j - 1) % (Z - 1) == 0) continue;
+                if (i == 1 || i == (N - 1) * (M - 1) + 1)
+                    pushNode(Left + (j - 1) * zx, Bottom + (i - 1) * my, 1);
+                else
+                    pushNode(Left + (j - 1) * zx, Bottom + (i - 1) * my, 0);
+            }
+        }
+    }
+
+    // new node on col edge
+    for (int j = 1; j <= (N - 1) * (M - 1) + 1; j++) {
+        if (j > 2 && j < (N - 1) * (M - 1) ) {
+            for (int i = 2; i <= Z - 1; i++)
+                pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * zy, 0);
+            for (int i = 2; i <= Z - 1; i++)
+                pushNode(Left + (j - 1) * mx, Bottom + Height - my + (i - 1) * zy, 0);
+        } else {
+            for (int i = 2; i <= (M - 1) * (N - 1) * (Z - 1); i++) {
+                if ((i - 1) % (Z - 1) == 0) continue;
+                if (j == 1 || j == (N - 1) * (M - 1) + 1)
+                    pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * zy, 1);
+                else
+                    pushNode(Left + (j - 1) * mx, Bottom + (i - 1) * zy, 0);
+            }
+        }
+    }
+
+    // inside each square
+    for (int i = 1; i <= (N - 1) * (M - 1); i++)
+        for (int j = 1; j <= (N - 1) * (M - 1); j++) {
+            if (i > 1 && i < (N - 1) * (M - 1) && j > 1 && j < (N - 1) * (M - 1) ) continue;
+            double startx = Left + (j - 1) * mx;
+            double starty = Bottom + (i - 1) * my;
+            for (int zi = 2; zi <= Z - 1; zi++)
+                for (int zj = 2; zj <= Z - 1; zj++)
+                    pushNode(startx + (zj - 1) * zx, starty + (zi - 1) * zy, 0);
+        }
+}
+
+void SquareMeshGenerator::genRefineRoundEdge1(int j, int i, int flagBottom, int flagRight, int flagTop, int flagLeft)
+{
+    double startx = Left + (j - 1) * mx;
+    double starty = Bottom + (i - 1) * my;
+    int startV1 = findNode(startx, starty);
+    int startV2 = findNode(startx + mx, starty);
+    int startV3 = findNode(startx, starty + my);
+    int startV4 = findNode(startx + mx, starty + my);
+
+    int indexEdgeBottom = findEdge(startV1, startV2);
+    int indexEdgeTop = findEdge(startV3, startV4);
+    int indexEdgeLeft = findEdge(startV1, startV3);
+    int indexEdgeRight = findEdge(startV2, startV4);
+    int indexEdgeDiag = findEdge(startV1, startV4);
+
+    int indexNodeBottom = findNode(Left + (j - 1) * mx + zx, Bottom + (i - 1) * my);
+    int indexNodeTop = findNode(Left + (j - 1) * mx + zx, Bottom + i * my);
+    int indexNodeLeft = findNode(Left + (j - 1) * mx, Bottom + (i - 1) * my + zy);
+    int indexNodeRight = findNode(Left + j * mx, Bottom + (i - 1) * my + zy);
+
+    if (flagBottom)
+        genSquareEdge(indexEdgeBottom, indexNodeBottom, Z);
+
+    if (flagTop)
+        genSquareEdge(indexEdgeTop, indexNodeTop, Z);
+
+    if (flagLeft)
+        genSquareEdge(indexEdgeLeft, indexNodeLeft, Z);
+
+    if (flagRight)
+        genSquareEdge(indexEdgeRight, indexNodeRight, Z);
+
+    // interior row
+    for (int ii = 2; ii <= Z - 1; ii++) {
+        for (int jj = 1; jj <= Z - 1; jj++) {
+            int left = findNode(startx + (jj - 1) * zx, starty + (ii - 1) * zy);
+            int right = findNode(startx + jj * zx, starty + (ii - 1) * zy);
+            pushEdge(left, right, 0, 0);
+        }
+    }
+
+    // interior col
+    for (int jj = 2; jj <= Z - 1; jj++) {
+        for (int ii = 1; ii <= Z - 1; ii++) {
+            int bottom = findNode(startx + (jj - 1) * zx, starty + (ii - 1) * zy);
+            int top = findNode(startx + (jj - 1) * zx, starty + ii * zy);
+            pushEdge(bottom, top, 0, 0);
+        }
+    }
+
+    // diag
+    for (int ii = 1; ii <= Z - 1; ii++) {
+        for (int jj = 1; jj <= Z - 1; jj++) {
+            int v1 = findNode(startx + (jj - 1) * zx, starty + (ii - 1) * zy);
+            int v2 = findNode(startx + jj * zx, starty + ii * zy);
+            if (ii == jj)
+                pushEdge(v1, v2, 0, indexEdgeDiag);
+            else
+                pushEdge(v1, v2, 0, 0);
+        }
+    }
+}
+
+void SquareMeshGenerator::genRefineRoundElement1()
+{
+    for (int i = 1; i <= (N - 1) * (M - 1); i++)
+        for (int j = 1; j <= (N - 1) * (M - 1); j++) {
+            if (i > 1 && i < (N - 1) * (M - 1) && j > 1 && j < (N - 1) * (M - 1) ) continue;
+            double startx = Left + (j - 1) * mx;
+            double starty = Bottom + (i - 1) * my;
+            int startV1 = findNode(startx, starty);
+            int startV2 = findNode(startx + mx, starty);
+            int startV3 = findNode(startx, starty + my);
+            int startV4 = findNode(startx + mx, starty + my);
+            int element1 = findElement(startV1, startV4, startV3);
+            int element2 = findElement(startV1, startV2, startV4);
+
+            for (int ii = 1; ii <= Z - 1; ii++)
+                for (int jj = 1; jj <= Z - 1; jj ++) {
+                    int v1 = findNode(startx + (jj - 1) * zx, starty + (ii - 1) * zy);
+                    int v2 = findNode(startx + jj * zx, starty + (ii - 1) * zy);
+                    int v3 = findNode(startx + (jj - 1) * zx, starty + ii * zy);
+                    int v4 = findNode(startx + jj * zx, starty + ii * zy);
+
+                    if (ii >= jj)
+                        pushElement(v1, v4, v3, element1);
+                    else
+                        pushElement(v1, v4, v3, element2);
+
+                    if (ii <= jj)
+                        pushElement(v1, v2, v4, element2);
+                    else
+                        pushElement(v1, v2, v4, element1);
+                }
+        }
+}
+
+void SquareMeshGenerator::writeFiles(const string &filename) const
+{
+    for (string polyFile : {filename + ".poly", filename + ".1.poly"}) {
+        std::ofstream fout(polyFile.c_str());
+        fout << "4  2  0  1" << std::endl
+             << "   1\t" << Left << "\t" << Bottom << "\t" << "1" << std::endl
+             << "   2\t" << Left + Width << "\t" << Bottom << "\t" << "1" << std::endl
+             << "   3\t" << Left + Width << "\t" << Bottom + Height << "\t" << "1" << std::endl
+             << "   4\t" << Left << "\t" << Bottom + Height << "\t" << "1" << std::endl;
+        fout << "4  1" << std::endl
+             << "   1\t1\t2\t1" << std::endl
+             << "   2\t2\t3\t1" << std::endl
+             << "   3\t3\t4\t1" << std::endl
+             << "   4\t4\t1\t1" << std::endl;
+        fout << "0" << std::endl;
+    }
+
+    {
+        OutputFile fout(filename + ".1.node");
+        fout << numCoarseNode() << "  " << "2  0  1" << '\n';
+        for (int i = 1; i <= numCoarseNode(); i++) {
+            Node node = coarseNode(i);
+            fout << "   " << node.index << '\t' << node.x << '\t' << node.y << '\t' << node.bctype << '\n';
+        }
+    }
+
+    {
+        OutputFile fout(filename + ".1.ele");
+        fout << numCoarseElement() << "  " << "3  0" << '\n';
+        for (int i = 1; i <= numCoarseElement(); i++) {
+            Element element = coarseElement(i);
+            fout << "   " << element.index << '\t' << element.v1 << '\t' << element.v2 << '\t' << element.v3 << '\n';
+        }
+    }
+
+    {
+        OutputFile fout(filename + ".1.edge");
+        fout << numCoarseEdge() << "  1" << '\n';
+        for (int i = 1; i <= numCoarseEdge(); i++) {
+            Edge edge = coarseEdge(i);
+            fout << "   " << edge.index << '\t' << edge.v1 << '\t' << edge.v2 << '\t' << edge.bctype << '\n';
+        }
+    }
+
+    for (int level = 0; level < nRefine; level++) {
+        OutputFile fout(filename + ".1.ref" + std::to_string(level));
+
+        fout << node[level].size() << '\n';
+        for (const Node &n : node[level])
+            fout << "   " << n.index << '\t' << n.x << '\t' << n.y << '\t' << n.bctype << '\n';
+
+        // each group of new edges and elements is headed by its parent
+        fout << edge[level].size() << '\n';
+        int currentParent = -1;
+        for (const Edge &e : edge[level]) {
+            if (e.parent != currentParent) {
+                currentParent = e.parent;
+                fout << '\t' << e.parent << '\n';
+            }
+            fout << "\t\t" << e.index << '\t' << e.v1 << '\t' << e.v2 << '\n';
+        }
+
+        fout << element[level].size() << '\n';
+        currentParent = -1;
+        for (const Element &e : element[level]) {
+            if (e.parent != currentParent) {
+                currentParent = e.parent;
+                fout << '\t' << e.parent << '\n';
+            }
+            fout << "\t\t" << e.index << '\t' << e.v1 << '\t' << e.v2 << '\t' << e.v3 << '\n';
+        }
+    }
+}
@@ -0,0 +1,108 @@
+//
+//  SquareMesh.h
+//  tri
+//
+//  The structured square mesh of meshgen, generated in memory: N x N
+// vertices with each square cut into two triangles. Refinement level 0
+// splits the squares along the boundary into (M - 1) x (M - 1) squares,
+// level 1 does the same with the new squares along the boundary and Z.
+// meshgen writes it to text files, Mesh::generateSquare fills a Mesh
+// from it directly.
+
+#ifndef __tri__SquareMesh__
+#define __tri__SquareMesh__
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+class SquareMeshGenerator {
+public:
+    // records as in the *.node, *.edge, *.ele and *.refN files
+    struct Node {
+        int index;
+        double x, y;
+        int bctype;
+    };
+    struct Edge {
+        int index;
+        int v1, v2;
+        int bctype;
+        int parent;  // refined edge, 0 for a new edge inside a refined element
+    };
+    struct Element {
+        int index;
+        int v1, v2, v3;
+        int parent;
+    };
+
+    static const int maxRefine = 2;
+
+    SquareMeshGenerator(int n, int m = 3, int z = 3);
+
+    int numCoarseNode() const { return N * N; }
+    int numCoarseEdge() const { return (N - 1) * (3 * N - 1); }
+    int numCoarseElement() const { return 2 * (N - 1) * (N - 1); }
+    Node coarseNode(int index) const;
+    Edge coarseEdge(int index) const;
+    Element coarseElement(int index) const;
+
+    void refine(); // generate the next refinement level
+    int numRefine() const { return nRefine; }
+
+    // new nodes, edges and elements of a refinement level, in the order of *.refN
+    const std::vector<Node> &refNode(int level) const { return node[level]; }
+    const std::vector<Edge> &refEdge(int level) const { return edge[level]; }
+    const std::vector<Element> &refElement(int level) const { return element[level]; }
+
+    // write filename.poly, filename.1.poly, .node, .ele, .edge and .refN as meshgen does
+    void writeFiles(const std::string &filename) const;
+
+private:
+    struct VertexTriple {
+        int v1, v2, v3;
+        bool operator==(const VertexTriple &t) const { return v1 == t.v1 && v2 == t.v2 && v3 == t.v3; }
+    };
+    struct VertexTripleHash {
+        size_t operator()(const VertexTriple &t) const
+        {
+            return ((size_t) t.v1 * 73856093u) ^ ((size_t) t.v2 * 19349663u) ^ ((size_t) t.v3 * 83492791u);
+        }
+    };
+
+    int N, M, Z;
+    int nRefine;
+    double hx, hy, mx, my, zx, zy;
+    double fx, fy;       // every node lies on the lattice of spacing fx, fy
+    long long nLattice;  // lattice points per row
+
+    std::vector<Node> node[maxRefine];
+    std::vector<Edge> edge[maxRefine];
+    std::vector<Element> element[maxRefine];
+
+    // refinement nodes by lattice point, edges by (v1, v2), elements by (v1, v2, v3)
+    std::unordered_map<long long, int> nodeIndex;
+    std::unordered_map<long long, int> edgeIndex;
+    std::unordered_map<VertexTriple, int, VertexTripleHash> elementIndex;
+
+    int numNode() const;
+    int numEdge() const;
+    int numElement() const;
+    Edge edgeAt(int index) const;
+    int findNode(double x, double y) const;
+    int findEdge(int v1, int v2) const;
+    int findElement(int v1, int v2, int v3) const;
+    void pushNode(double x, double y, int bctype);
+    void pushEdge(int v1, int v2, int bctype, int parent);
+    void pushElement(int v1, int v2, int v3, int parent);
+
+    void genSquareEdge(int indexEdge, int indexNode, int m);
+    void genRefineRoundNode();
+    void genRefineRoundEdge(int j, int i, int flagBottom, int flagRight, int flagTop, int flagLeft);
+    void genRefineRoundElement();
+    void genRefineRoundNode1();
+    void genRefineRoundEdge1(int j, int i, int flagBottom, int flagRight, int flagTop, int flagLeft);
+    void genRefineRoundElement1();
+};
+
+#endif /* defined(__tri__SquareMesh__) */
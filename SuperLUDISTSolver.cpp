@@ -7,11 +7,16 @@
 //
 
 #include "SuperLUDISTSolver.h"
+#include "FormatBuffer.h"
+#include "MPIFile.h"
+#include <stdexcept>
+#include <algorithm>
 
 SuperLUDISTSolver::SuperLUDISTSolver(std::vector< std::list<maColEle> > &ma, int femDof,
                                      double *femRH, gridinfo_t *superlu_grid, int femm_loc, int femfst_row)
     : LinearSolver(ma, femDof, femRH), m_loc(femm_loc), fst_row(femfst_row)
 {
+    PhaseTimer timer(Phase::CSCConversion);
     grid = superlu_grid;
 
     nnz_loc = 0;
@@ -43,6 +48,29 @@ SuperLUDISTSolver::SuperLUDISTSolver(std::vector< std::list<maColEle> > &ma, int
 
 }
 
+// the entries of L and U stored on this processor, counted as dQuerySpace_dist counts their memory: the
+// local block columns of L with all rows of each supernode, and the local block rows of U
+static double localFactorNonzeros(int n, LUstruct_t *LUstruct, gridinfo_t *grid)
+{
+    int_t *xsup = LUstruct -> Glu_persist -> xsup;
+    LocalLU_t *Llu = LUstruct -> Llu;
+    int nsupers = LUstruct -> Glu_persist -> supno[n - 1] + 1;
+    double nonzeros = 0;
+    for (int k = 0; k < CEILING(nsupers, grid -> npcol); k++) {
+        int gb = k * grid -> npcol + MYCOL(grid -> iam, grid);
+        int_t *index = gb < nsupers ? Llu -> Lrowind_bc_ptr[k] : nullptr;
+        if (index)
+            nonzeros += (double) index[1] * SuperSize(gb);
+    }
+    for (int k = 0; k < CEILING(nsupers, grid -> nprow); k++) {
+        int gb = k * grid -> nprow + MYROW(grid -> iam, grid);
+        int_t *index = gb < nsupers ? Llu -> Ufstnz_br_ptr[k] : nullptr;
+        if (index)
+            nonzeros += index[1];
+    }
+    return nonzeros;
+}
+
 std::vector<double> SuperLUDISTSolver::solveSparse()
 {
     if (grid -> iam == 0)
@@ -69,6 +97,7 @@ std::vector<double> SuperLUDISTSolver::solveSparse()
        NOW WE SOLVE THE LINEAR SYSTEM.
        ------------------------------------------------------------*/
     set_default_options_dist(&options);
+    options.PrintStat = NO; // the statistics go to the run report
 
     int m = A.nrow;
     int n = A.ncol;
@@ -81,12 +110,45 @@ std::vector<double> SuperLUDISTSolver::solveSparse()
     PStatInit(&stat);
 
     /* Call the linear equation solver. */
+    PhaseTimer timer(Phase::NumericFactorization); // pdgssvx orders, factors and solves in one call
     pdgssvx(&options, &A, &ScalePermstruct, rh, m_loc, nrhs, grid,
             &LUstruct, &SOLVEstruct, berr, &stat, &info);
+    timer.stop();
     
     std::vector<double> v(rh, rh + m_loc); // save the solution
 
-    PStatPrint(&options, &stat, grid);        /* Print the statistics. */
+    mem_usage_t memory;
+    dQuerySpace_dist(n, &LUstruct, grid, &memory);
+
+    // the flops, nnz, factor entries and memory of all processors, the times of the slowest
+    double local[5] = {stat.ops[FACT], stat.ops[SOLVE], (double) nnz_loc, localFactorNonzeros(n, &LUstruct, grid),
+                       memory.total / 1048576.0}, sum[5];
+    double times[3] = {stat.utime[COLPERM] + stat.utime[ROWPERM] + stat.utime[SYMBFAC], stat.utime[FACT],
+                       stat.utime[SOLVE]}, slowest[3];
+    MPI_Allreduce(local, sum, 5, MPI_DOUBLE, MPI_SUM, grid -> comm);
+    MPI_Allreduce(times, slowest, 3, MPI_DOUBLE, MPI_MAX, grid -> comm);
+    std::vector<int> rowNonzeros(m_loc);
+    for (int r = 0; r < m_loc; r++)
+        rowNonzeros[r] = rowptr[r + 1] - rowptr[r];
+    std::vector<long long> histogram = rowHistogram(rowNonzeros);
+    histogram.resize(33, 0);
+    stats.rowHistogram.assign(33, 0);
+    MPI_Allreduce(histogram.data(), stats.rowHistogram.data(), 33, MPI_LONG_LONG, MPI_SUM, grid -> comm);
+    while (stats.rowHistogram.size() > 1 && stats.rowHistogram.back() == 0)
+        stats.rowHistogram.pop_back();
+    stats.nnz = (long long) sum[2];
+    stats.symbolicFactorizations++;
+    stats.symbolicSeconds += slowest[0];
+    stats.numericFactorizations++;
+    stats.numericSeconds += slowest[1];
+    stats.solveSeconds += slowest[2];
+    stats.solves++;
+    stats.factorFlops = sum[0];
+    stats.solveFlops = sum[1];
+    stats.factorNonzeros = sum[3];
+    stats.peakMB = sum[4];
+    stats.backwardError = berr[0];
+    reportStatistics(printStats && grid -> iam == 0);
 
     /* ------------------------------------------------------------
        DEALLOCATE STORAGE.
@@ -109,3 +171,66 @@ std::vector<double> SuperLUDISTSolver::solveSparse()
 
     return v;
 }
+
+// the entries of the processors one after the other
+void SuperLUDISTSolver::writeMatrixMarket(const std::string &filename) const
+{
+    long long nnz = Ap[dof], total(0);
+    MPI_Allreduce(&nnz, &total, 1, MPI_LONG_LONG, MPI_SUM, grid -> comm);
+    
+    FormatBuffer out(nullptr, 17);
+    if (grid -> iam == 0)
+        out << "%%MatrixMarket matrix coordinate real general\n" << dof << ' ' << dof << ' ' << total << '\n';
+    for (int col = 0; col < dof; col++)
+        for (int k = Ap[col]; k < Ap[col + 1]; k++)
+            out << Ai[k] + fst_row + 1 << ' ' << col + 1 << ' ' << Ax[k] << '\n';
+    
+    writeShared(grid -> comm, filename, out.data(), out.size());
+}
+
+// column col of the matrix holds the rows of processor 0, then those of processor 1 and so on, so
+// each processor writes its part of a column at Ap[col] plus the entries of col on the processors before it
+void SuperLUDISTSolver::writeBinaryCSC(const std::string &filename) const
+{
+    std::vector<int> count(dof), before(dof, 0), globalAp(dof + 1, 0);
+    for (int col = 0; col < dof; col++)
+        count[col] = Ap[col + 1] - Ap[col];
+    MPI_Allreduce(count.data(), globalAp.data() + 1, dof, MPI_INT, MPI_SUM, grid -> comm);
+    MPI_Exscan(count.data(), before.data(), dof, MPI_INT, MPI_SUM, grid -> comm);
+    if (grid -> iam == 0)
+        std::fill(before.begin(), before.end(), 0);
+    for (int col = 0; col < dof; col++)
+        globalAp[col + 1] += globalAp[col];
+    
+    int nnz = Ap[dof];
+    std::vector<int> rows(Ai, Ai + nnz), displacement(dof);
+    for (int &row : rows)
+        row += fst_row;
+    for (int col = 0; col < dof; col++)
+        displacement[col] = globalAp[col] + before[col];
+    
+    MPI_File fh = openShared(grid -> comm, filename);
+    MPI_Offset headerSize = 8 + 2 * sizeof(int64_t), apSize = (dof + 1) * sizeof(int);
+    if (grid -> iam == 0) {
+        int64_t size[2] = {dof, globalAp[dof]};
+        writeBytesAt(fh, 0, "TRICSC1\n", 8);
+        writeBytesAt(fh, 8, reinterpret_cast<const char *>(size), sizeof(size));
+        writeBytesAt(fh, headerSize, reinterpret_cast<const char *>(globalAp.data()), apSize);
+    }
+    
+    MPI_Datatype rowType, valueType;
+    MPI_Type_indexed(dof, count.data(), displacement.data(), MPI_INT, &rowType);
+    MPI_Type_indexed(dof, count.data(), displacement.data(), MPI_DOUBLE, &valueType);
+    MPI_Type_commit(&rowType);
+    MPI_Type_commit(&valueType);
+    
+    char native[] = "native";
+    MPI_File_set_view(fh, headerSize + apSize, MPI_INT, rowType, native, MPI_INFO_NULL);
+    MPI_File_write_all(fh, rows.data(), nnz, MPI_INT, MPI_STATUS_IGNORE);
+    MPI_File_set_view(fh, headerSize + apSize + (MPI_Offset) globalAp[dof] * sizeof(int), MPI_DOUBLE, valueType, native, MPI_INFO_NULL);
+    MPI_File_write_all(fh, Ax, nnz, MPI_DOUBLE, MPI_STATUS_IGNORE);
+    
+    MPI_Type_free(&rowType);
+    MPI_Type_free(&valueType);
+    MPI_File_close(&fh);
+}
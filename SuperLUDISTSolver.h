@@ -23,6 +23,10 @@ public:
                       int femDof, double *femRH, gridinfo_t *superlu_grid, int m_loc, int fst_row);
 
     std::vector<double> solveSparse();  // call SuperLU to solve the sparse linear system
+
+    // every processor writes its rows into the one file with MPI-IO, collective over the grid
+    void writeMatrixMarket(const std::string &filename) const;
+    void writeBinaryCSC(const std::string &filename) const;
     ~SuperLUDISTSolver()
     {
         delete [] nzval_loc;
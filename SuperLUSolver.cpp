@@ -7,11 +7,200 @@
 //
 
 #include "SuperLUSolver.h"
+#include "SinglePrecisionLU.h"
 #include "../SuperLU_4.3/SRC/slu_ddefs.h"
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+    template <typename T>
+    bool writeArray(FILE *f, const T *data, int n)
+    {
+        return fwrite(data, sizeof(T), n, f) == (size_t) n;
+    }
+    
+    bool readArray(FILE *f, int *&data, int n)
+    {
+        data = intMalloc(std::max(n, 1));
+        return fread(data, sizeof(int), n, f) == (size_t) n;
+    }
+    
+    bool readArray(FILE *f, double *&data, int n)
+    {
+        data = doubleMalloc(std::max(n, 1));
+        return fread(data, sizeof(double), n, f) == (size_t) n;
+    }
+    
+    const char FactorMagic[8] = {'T', 'R', 'I', 'S', 'L', 'U', '1', '\n'};
+    
+    // L in supernodal and U in compressed column form as dgssv leaves them, with the permutations;
+    // the header holds n, the nnz and nsuper of L, the nnz of U and the lengths of the arrays of L and U
+    bool saveFactors(const std::string &file, int n, SuperMatrix &L, SuperMatrix &U, const int *perm_c, const int *perm_r)
+    {
+        FILE *f = fopen(file.c_str(), "wb");
+        if (!f)
+            return false;
+        SCformat *Ls = (SCformat *) L.Store;
+        NCformat *Us = (NCformat *) U.Store;
+        int size[7] = {n, Ls -> nnz, Ls -> nsuper, Us -> nnz, Ls -> nzval_colptr[n], Ls -> rowind_colptr[n], Us -> colptr[n]};
+        bool ok = fwrite(FactorMagic, 1, 8, f) == 8 && writeArray(f, size, 7)
+            && writeArray(f, (double *) Ls -> nzval, size[4]) && writeArray(f, Ls -> nzval_colptr, n + 1)
+            && writeArray(f, Ls -> rowind, size[5]) && writeArray(f, Ls -> rowind_colptr, n + 1)
+            && writeArray(f, Ls -> col_to_sup, n) && writeArray(f, Ls -> sup_to_col, size[2] + 2)
+            && writeArray(f, (double *) Us -> nzval, size[6]) && writeArray(f, Us -> rowind, size[6])
+            && writeArray(f, Us -> colptr, n + 1) && writeArray(f, perm_c, n) && writeArray(f, perm_r, n);
+        return fclose(f) == 0 && ok;
+    }
+    
+    // the arrays are allocated as SuperLU does, so the Destroy functions free them
+    bool loadFactors(const std::string &file, int n, SuperMatrix &L, SuperMatrix &U, int *perm_c, int *perm_r)
+    {
+        FILE *f = fopen(file.c_str(), "rb");
+        if (!f)
+            return false;
+        char magic[8];
+        int size[7];
+        if (fread(magic, 1, 8, f) != 8 || memcmp(magic, FactorMagic, 8) != 0
+            || fread(size, sizeof(int), 7, f) != 7 || size[0] != n) {
+            fclose(f);
+            return false;
+        }
+        
+        double *Lnzval, *Unzval;
+        int *nzval_colptr, *Lrowind, *rowind_colptr, *col_to_sup, *sup_to_col, *Urowind, *colptr;
+        bool ok = readArray(f, Lnzval, size[4]);
+        ok = readArray(f, nzval_colptr, n + 1) && ok;
+        ok = readArray(f, Lrowind, size[5]) && ok;
+        ok = readArray(f, rowind_colptr, n + 1) && ok;
+        ok = readArray(f, col_to_sup, n) && ok;
+        ok = readArray(f, sup_to_col, size[2] + 2) && ok;
+        ok = readArray(f, Unzval, size[6]) && ok;
+        ok = readArray(f, Urowind, size[6]) && ok;
+        ok = readArray(f, colptr, n + 1) && ok;
+        ok = fread(perm_c, sizeof(int), n, f) == (size_t) n && ok;
+        ok = fread(perm_r, sizeof(int), n, f) == (size_t) n && ok;
+        fclose(f);
+        
+        dCreate_SuperNode_Matrix(&L, n, n, size[1], Lnzval, nzval_colptr, Lrowind, rowind_colptr,
+                                 col_to_sup, sup_to_col, SLU_SC, SLU_D, SLU_TRLU);
+        dCreate_CompCol_Matrix(&U, n, n, size[3], Unzval, Urowind, colptr, SLU_NC, SLU_D, SLU_TRU);
+        if (!ok) {
+            Destroy_SuperNode_Matrix(&L);
+            Destroy_CompCol_Matrix(&U);
+        }
+        return ok;
+    }
+}
+
+struct SuperLUSolver::Factors {
+    SuperMatrix L, U;
+    int *perm_c, *perm_r;
+};
+
+SuperLUSolver::~SuperLUSolver()
+{
+    releaseFactors();
+}
+
+void SuperLUSolver::releaseFactors()
+{
+    if (kept != nullptr) {
+        SUPERLU_FREE (kept -> perm_r);
+        SUPERLU_FREE (kept -> perm_c);
+        Destroy_SuperNode_Matrix(&kept -> L);
+        Destroy_CompCol_Matrix(&kept -> U);
+        delete kept;
+        kept = nullptr;
+    }
+    delete keptSingle;
+    keptSingle = nullptr;
+}
+
+bool SuperLUSolver::solveMixed(std::vector<double> &x)
+{
+    SinglePrecisionLU *lu = new SinglePrecisionLU;
+    PhaseTimer timer(Phase::NumericFactorization);
+    bool factored = lu -> factor(dof, Ap, Ai, Ax, naturalOrdering);
+    stats.numericSeconds += timer.stop();
+    stats.numericFactorizations++;
+    if (factored) {
+        stats.factorNonzeros = lu -> factorNonzeros();
+        stats.peakMB = lu -> factorBytes() / 1048576.0;
+        RunReport::setValue("factor_mb", stats.peakMB);
+    }
+    
+    bool converged = factored && refine(*lu, rh, x);
+    if (converged && keepFactors)
+        keptSingle = lu;
+    else
+        delete lu;
+    return converged;
+}
+
+// as LAPACK dsgesv: x += A_single^{-1} (b - A x) with the residual in double, until the backward error
+// ||r|| <= ||x|| ||A|| eps sqrt(n) in the max norm, in at most 30 steps
+bool SuperLUSolver::refine(const SinglePrecisionLU &lu, const double *b, std::vector<double> &x)
+{
+    const int maxSteps = 30;
+    PhaseTimer solveTimer(Phase::Solve);
+    std::vector<double> rowSum(dof, 0), r(b, b + dof);
+    std::vector<float> d(dof);
+    for (int k = 0; k < Ap[dof]; k++)
+        rowSum[Ai[k]] += std::fabs(Ax[k]);
+    double normA = *std::max_element(rowSum.begin(), rowSum.end());
+    double tolerance = normA * std::numeric_limits<double>::epsilon() * std::sqrt((double) dof);
+    
+    x.assign(dof, 0);
+    for (int step = 0; ; step++) {
+        if (step > 0) {
+            r.assign(b, b + dof);
+            for (int col = 0; col < dof; col++)
+                for (int k = Ap[col]; k < Ap[col + 1]; k++)
+                    r[Ai[k]] -= Ax[k] * x[col];
+        }
+        double normR(0), normX(0);
+        for (int i = 0; i < dof; i++) {
+            normR = std::max(normR, std::fabs(r[i]));
+            normX = std::max(normX, std::fabs(x[i]));
+        }
+        RunReport::setValue("refinement_steps", std::max(step - 1, 0));
+        RunReport::setValue("refinement_backward_error", normX > 0 ? normR / (normX * normA) : 0);
+        bool converged = normR == 0 || (step > 0 && normR <= normX * tolerance);
+        if (converged || step == maxSteps) {
+            stats.solveSeconds += solveTimer.stop();
+            return converged;
+        }
+        
+        // the residual is scaled so that the single precision solve neither overflows nor underflows
+        for (int i = 0; i < dof; i++)
+            d[i] = (float) (r[i] / normR);
+        lu.solve(d.data());
+        for (int i = 0; i < dof; i++)
+            x[i] += normR * d[i];
+    }
+}
 
 std::vector<double> SuperLUSolver::solveSparse()
 {
     std::cout << "start solving with SuperLU" << std::endl;
+    releaseFactors();
+    
+    if (mixedPrecision) {
+        std::vector<double> x;
+        bool converged = solveMixed(x);
+        RunReport::setValue("refinement_fallback", !converged);
+        if (converged) {
+            finishSolve(rh, x, printStats);
+            std::cout << "finish solving with SuperLU in single precision, " << RunReport::value("refinement_steps")
+                      << " refinement steps\n" << std::endl;
+            return x;
+        }
+        std::cout << "refinement in single precision did not converge, factoring in double" << std::endl;
+    }
     
     superlu_options_t options;
     set_default_options(&options);
@@ -20,10 +209,11 @@ std::vector<double> SuperLUSolver::solveSparse()
 
     SuperMatrix A, B;
     dCreate_CompCol_Matrix(&A, dof, dof, nnz, Ax, Ai, Ap, SLU_NC, SLU_D, SLU_GE);
-    dCreate_Dense_Matrix(&B, dof, 1, rh, dof, SLU_DN, SLU_D, SLU_GE);
+    std::vector<double> b(rh, rh + dof); // overwritten by the solution, rh stays for output and later solves
+    dCreate_Dense_Matrix(&B, dof, 1, b.data(), dof, SLU_DN, SLU_D, SLU_GE);
 
     set_default_options(&options);
-    options.ColPerm = NATURAL;
+    options.ColPerm = naturalOrdering ? NATURAL : COLAMD;
 
     int      *perm_c; /* column permutation vector */
     int      *perm_r; /* row permutations from partial pivoting */
@@ -35,21 +225,99 @@ std::vector<double> SuperLUSolver::solveSparse()
     SuperLUStat_t stat;
     StatInit(&stat);
 
-    dgssv(&options, &A, perm_c, perm_r, &L, &U, &B, &stat, &info);
+    // a factorization saved by an earlier run with the same matrix goes straight to the triangular solves
+    std::string file = factorFile("superlu");
+    PhaseTimer timer(Phase::NumericFactorization); // dgssv orders, factors and solves in one call
+    bool loaded = !file.empty() && loadFactors(file, dof, L, U, perm_c, perm_r);
+    RunReport::setValue("factor_loaded", loaded);
+    if (loaded) {
+        timer.stop();
+        std::cout << "loaded the factorization from " << file << std::endl;
+        PhaseTimer solveTimer(Phase::Solve);
+        dgstrs(NOTRANS, &L, &U, perm_c, perm_r, &B, &stat, &info);
+        stats.solveSeconds += solveTimer.stop();
+        stats.solveFlops = stat.ops[SOLVE];
+    } else {
+        dgssv(&options, &A, perm_c, perm_r, &L, &U, &B, &stat, &info);
+        timer.stop();
+        // dgssv times its steps in stat, the ordering and elimination tree being the symbolic part
+        stats.symbolicFactorizations++;
+        stats.numericFactorizations++;
+        stats.symbolicSeconds += stat.utime[COLPERM] + stat.utime[ETREE];
+        stats.numericSeconds += stat.utime[FACT];
+        stats.solveSeconds += stat.utime[SOLVE];
+        stats.factorFlops = stat.ops[FACT];
+        stats.solveFlops = stat.ops[SOLVE];
+        if (info == 0) {
+            mem_usage_t mem;
+            dQuerySpace(&L, &U, &mem);
+            stats.factorNonzeros = ((SCformat *) L.Store)->nnz + ((NCformat *) U.Store)->nnz;
+            stats.peakMB = mem.total_needed / 1048576.0;
+            stats.pivotGrowth = dPivotGrowth(dof, &A, perm_c, &L, &U);
+            RunReport::setValue("factor_mb", mem.for_lu / 1048576.0);
+            if (!file.empty() && !saveFactors(file, dof, L, U, perm_c, perm_r))
+                std::cout << "could not save the factorization to " << file << std::endl;
+        }
+    }
 
     double *sol = (double *) ((DNformat *) B.Store)->nzval;
     std::vector<double> v(sol, sol + dof);
 
     StatFree(&stat);
 
-    SUPERLU_FREE (perm_r);
-    SUPERLU_FREE (perm_c);
     // Destroy_CompCol_Matrix(&A);
     Destroy_SuperMatrix_Store(&B);
-    Destroy_SuperNode_Matrix(&L);
-    Destroy_CompCol_Matrix(&U);
+    if (keepFactors && (loaded || info == 0)) {
+        kept = new Factors;
+        kept -> L = L;
+        kept -> U = U;
+        kept -> perm_c = perm_c;
+        kept -> perm_r = perm_r;
+    } else {
+        SUPERLU_FREE (perm_r);
+        SUPERLU_FREE (perm_c);
+        Destroy_SuperNode_Matrix(&L);
+        Destroy_CompCol_Matrix(&U);
+    }
 
+    finishSolve(rh, v, printStats);
     std::cout << "finish solving with SuperLU\n" << std::endl;
 
     return v;
-}
\ No newline at end of file
+}
+// a single precision factorization that no longer reaches double accuracy is replaced by one in double
+std::vector<double> SuperLUSolver::solve(const std::vector<double> &b)
+{
+    std::vector<double> x;
+    if (keptSingle != nullptr) {
+        if (refine(*keptSingle, b.data(), x)) {
+            finishSolve(b.data(), x, false);
+            return x;
+        }
+        std::cout << "refinement in single precision did not converge, factoring in double" << std::endl;
+        double *savedRH = rh;
+        rh = const_cast<double *>(b.data());
+        mixedPrecision = false;
+        x = solveSparse();
+        mixedPrecision = true;
+        rh = savedRH;
+        return x;
+    }
+    if (kept == nullptr)
+        throw std::runtime_error("no factorization kept by SuperLU");
+    
+    x = b;
+    SuperMatrix B;
+    dCreate_Dense_Matrix(&B, dof, 1, x.data(), dof, SLU_DN, SLU_D, SLU_GE);
+    SuperLUStat_t stat;
+    StatInit(&stat);
+    int info;
+    PhaseTimer solveTimer(Phase::Solve);
+    dgstrs(NOTRANS, &kept -> L, &kept -> U, kept -> perm_c, kept -> perm_r, &B, &stat, &info);
+    stats.solveSeconds += solveTimer.stop();
+    stats.solveFlops = stat.ops[SOLVE];
+    StatFree(&stat);
+    Destroy_SuperMatrix_Store(&B);
+    finishSolve(b.data(), x, false);
+    return x;
+}
@@ -11,14 +11,33 @@
 
 #include "LinearSolver.h"
 
+class SinglePrecisionLU;
+
 class SuperLUSolver: public LinearSolver
 {
+    bool naturalOrdering; // natural column ordering, COLAMD otherwise
+    bool mixedPrecision;  // factor in single precision and refine in double
+
+    struct Factors;       // L, U and the permutations of dgssv, see SuperLUSolver.cpp
+    Factors *kept;        // kept for solve if asked to
+    SinglePrecisionLU *keptSingle;
+    void releaseFactors();
+
+    bool solveMixed(std::vector<double> &x); // false if the refinement does not reach double accuracy
+    bool refine(const SinglePrecisionLU &lu, const double *b, std::vector<double> &x);
 public:
     SuperLUSolver(std::vector< std::list<maColEle> > &ma,
                   int femDof, double *femRH)
-        : LinearSolver(ma, femDof, femRH) {};
+        : LinearSolver(ma, femDof, femRH), naturalOrdering(true), mixedPrecision(false), kept(nullptr), keptSingle(nullptr) {};
+    SuperLUSolver(const std::string &stagedFile, int femDof, double *femRH)
+        : LinearSolver(stagedFile, femDof, femRH), naturalOrdering(true), mixedPrecision(false), kept(nullptr), keptSingle(nullptr) {};
+    ~SuperLUSolver();
+
+    void setNaturalOrdering(bool natural) { naturalOrdering = natural; }
+    void setMixedPrecision(bool mixed) { mixedPrecision = mixed; }
 
     std::vector<double> solveSparse();  // call SuperLU to solve the sparse linear system
+    std::vector<double> solve(const std::vector<double> &b);
 };
 
 
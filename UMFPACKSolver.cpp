@@ -8,24 +8,83 @@
 
 #include "UMFPACKSolver.h"
 #include <umfpack.h>
+#include <stdexcept>
+
+UMFPACKSolver::~UMFPACKSolver()
+{
+    if (Symbolic != NULL)
+        umfpack_di_free_symbolic (&Symbolic) ;
+    if (Numeric != NULL)
+        umfpack_di_free_numeric (&Numeric) ;
+}
 
 std::vector<double> UMFPACKSolver::solveSparse()
 {
     std::cout << "start solving with UMFPACK" << std::endl;
     double* x = new double [dof];
     memset(x, 0, dof * sizeof(double));
-    void *Symbolic, *Numeric ;
-    (void) umfpack_di_symbolic (dof, dof, Ap, Ai, Ax, &Symbolic, NULL, NULL) ;
-    (void) umfpack_di_numeric (Ap, Ai, Ax, Symbolic, &Numeric, NULL, NULL) ;
-    umfpack_di_free_symbolic (&Symbolic) ;
-    (void) umfpack_di_solve (UMFPACK_A, Ap, Ai, Ax, x, rh, Numeric, NULL, NULL) ;
-    umfpack_di_free_numeric (&Numeric) ;
+    if (Numeric != NULL)
+        umfpack_di_free_numeric (&Numeric) ;
+    double Control [UMFPACK_CONTROL], Info [UMFPACK_INFO] ;
+    umfpack_di_defaults (Control) ;
+    
+    // a factorization saved by an earlier run with the same matrix skips both factorizations
+    std::string file = factorFile("umfpack");
+    bool loaded = false;
+    if (!file.empty()) {
+        PhaseTimer loadTimer(Phase::NumericFactorization);
+        loaded = umfpack_di_load_numeric (&Numeric, const_cast<char *>(file.c_str())) == UMFPACK_OK;
+    }
+    RunReport::setValue("factor_loaded", loaded);
+    
+    if (loaded)
+        std::cout << "loaded the numeric factorization from " << file << std::endl;
+    else {
+        if (Symbolic == NULL) {
+            PhaseTimer symbolicTimer(Phase::SymbolicFactorization);
+            (void) umfpack_di_symbolic (dof, dof, Ap, Ai, Ax, &Symbolic, Control, Info) ;
+            stats.symbolicSeconds += symbolicTimer.stop();
+            stats.symbolicFactorizations++;
+        }
+        PhaseTimer numericTimer(Phase::NumericFactorization);
+        (void) umfpack_di_numeric (Ap, Ai, Ax, Symbolic, &Numeric, Control, Info) ;
+        stats.numericSeconds += numericTimer.stop();
+        stats.numericFactorizations++;
+        stats.factorNonzeros = Info [UMFPACK_LNZ] + Info [UMFPACK_UNZ] ;
+        stats.factorFlops = Info [UMFPACK_FLOPS] ;
+        stats.peakMB = Info [UMFPACK_PEAK_MEMORY] * Info [UMFPACK_SIZE_OF_UNIT] / 1048576.0 ;
+        stats.rcond = Info [UMFPACK_RCOND] ;
+        if (!file.empty() && umfpack_di_save_numeric (Numeric, const_cast<char *>(file.c_str())) != UMFPACK_OK)
+            std::cout << "could not save the numeric factorization to " << file << std::endl;
+    }
+    
+    PhaseTimer solveTimer(Phase::Solve);
+    (void) umfpack_di_solve (UMFPACK_A, Ap, Ai, Ax, x, rh, Numeric, Control, Info) ;
+    stats.solveSeconds += solveTimer.stop();
+    stats.solveFlops = Info [UMFPACK_SOLVE_FLOPS] ;
+    if (!keepFactors)
+        umfpack_di_free_numeric (&Numeric) ;
 
     std::vector<double> v(x, x + dof);
 
     delete [] x;
 
+    finishSolve(rh, v, printStats);
     std::cout << "finish solving with UMFPACK\n" << std::endl;
 
     return v;
-}
\ No newline at end of file
+}
+
+std::vector<double> UMFPACKSolver::solve(const std::vector<double> &b)
+{
+    if (Numeric == NULL)
+        throw std::runtime_error("no numeric factorization kept by UMFPACK");
+    std::vector<double> x(dof, 0);
+    double Info [UMFPACK_INFO] ;
+    PhaseTimer solveTimer(Phase::Solve);
+    (void) umfpack_di_solve (UMFPACK_A, Ap, Ai, Ax, x.data(), b.data(), Numeric, NULL, Info) ;
+    stats.solveSeconds += solveTimer.stop();
+    stats.solveFlops = Info [UMFPACK_SOLVE_FLOPS] ;
+    finishSolve(b.data(), x, false);
+    return x;
+}
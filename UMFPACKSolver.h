@@ -13,12 +13,18 @@
 
 class UMFPACKSolver: public LinearSolver
 {
+    void *Symbolic; // kept for later solves with the same pattern
+    void *Numeric;  // kept for solve if asked to
 public:
     UMFPACKSolver(std::vector< std::list<maColEle> > &ma,
                   int femDof, double *femRH)
-        : LinearSolver(ma, femDof, femRH) {};
+        : LinearSolver(ma, femDof, femRH), Symbolic(nullptr), Numeric(nullptr) {};
+    UMFPACKSolver(const std::string &stagedFile, int femDof, double *femRH)
+        : LinearSolver(stagedFile, femDof, femRH), Symbolic(nullptr), Numeric(nullptr) {};
+    ~UMFPACKSolver();
 
     std::vector<double> solveSparse();  // call UMFPACK to solve the sparse linear system
+    std::vector<double> solve(const std::vector<double> &b);
 };
 
 
@@ -7,23 +7,127 @@
 //
 
 #include <iostream>
+#include <sstream>
+#include <fstream>
+#include <chrono>
 #include "mesh.h"
 #include "BasicSolvingSystem.h"
 #include "DGSolvingSystem.h"
+#include "HDGSolvingSystem.h"
 #include "DGProblem.h"
 #include "problem.h"
 
 using namespace std;
 
+// solve every sweep case on the same mesh; between cases only the values of ma
+// and rh, the numeric factorization and the solve are redone
+static void runSweep(Problem &prob, BasicSolvingSystem *solSys)
+{
+    const string baseName = prob.parameters.meshFilename;
+    ostringstream table;
+    table << "case\tepsilon\tsigma0\tbeta0\terrL2\terrH1\tassembly\tcsc\tsymbolic\tnumeric\tsolve\ttotal" << endl;
+    
+    int k = 0;
+    for (const SweepCase &sweepCase : prob.parameters.sweep) {
+        ++k;
+        cout << "sweep case " << k << ": epsilon = " << sweepCase.epsilon << ", sigma0 = " << sweepCase.sigma0
+             << ", beta0 = " << sweepCase.beta0 << endl;
+        prob.epsilon = sweepCase.epsilon;
+        prob.sigma0 = sweepCase.sigma0;
+        prob.beta0 = sweepCase.beta0;
+        
+        vector<double> before(RunReport::times(), RunReport::times() + constPhaseCount);
+        auto spent = [&before](Phase phase) { return RunReport::time(phase) - before[static_cast<int>(phase)]; };
+        auto start = chrono::steady_clock::now();
+        
+        if (k == 1)
+            solSys -> assembleStiff();
+        else
+            solSys -> reassembleValues();
+        solSys -> solveSparse();
+        prob.parameters.meshFilename = baseName + ".case" + to_string(k);
+        solSys -> output();
+        
+        table << k << "\t" << sweepCase.epsilon << "\t" << sweepCase.sigma0 << "\t" << sweepCase.beta0
+              << "\t" << RunReport::value("errL2") << "\t" << RunReport::value("errH1")
+              << "\t" << spent(Phase::ElementAssembly) + spent(Phase::EdgeAssembly)
+              << "\t" << spent(Phase::CSCConversion) << "\t" << spent(Phase::SymbolicFactorization)
+              << "\t" << spent(Phase::NumericFactorization) << "\t" << spent(Phase::Solve)
+              << "\t" << chrono::duration<double>(chrono::steady_clock::now() - start).count() << endl;
+    }
+    prob.parameters.meshFilename = baseName;
+    RunReport::setValue("sweep_cases", k);
+    
+    cout << table.str();
+    ofstream fout((baseName + ".sweep").c_str());
+    fout << table.str();
+    cout << "sweep summary written to " << baseName << ".sweep" << endl;
+}
+
+// a sweep, Newton for a reaction term, time stepping and adaptive refinement each run on their own
+static void checkModes(Problem &prob)
+{
+    const paramstruct &param = prob.parameters;
+    if (prob.hasReaction() && !param.sweep.empty())
+        throw std::runtime_error("parameter sweeps are not supported for problems with a reaction term");
+    if (prob.hasReaction() && param.timeSteps > 0)
+        throw std::runtime_error("time stepping is not supported for problems with a reaction term");
+    if (prob.hasReaction() && param.nAdaptive > 0)
+        throw std::runtime_error("adaptive refinement is not supported for problems with a reaction term");
+    if (param.timeSteps > 0 && !param.sweep.empty())
+        throw std::runtime_error("parameter sweeps are not supported with time stepping");
+    if (param.timeSteps > 0 && param.nAdaptive > 0)
+        throw std::runtime_error("adaptive refinement is not supported with time stepping");
+    if (!param.sweep.empty() && param.nAdaptive > 0)
+        throw std::runtime_error("adaptive refinement is not supported in a parameter sweep");
+}
+
 int main(int argc, const char * argv[]) {
     try {
-        DGProblem prob(argc, argv);
+        DGProblem input(argc, argv);
+        std::unique_ptr<Problem> problem = createProblem(input);
+        Problem &prob = *problem;
+        checkModes(prob);
         Mesh mesh(&prob);
         
-        BasicSolvingSystem* solSys = new DGSolvingSystem(&mesh, &prob);
+        BasicSolvingSystem* solSys;
+        if (prob.parameters.hybridized)
+            solSys = new HDGSolvingSystem(&mesh, &prob);
+        else
+            solSys = new DGSolvingSystem(&mesh, &prob);
+        if (!prob.parameters.sweep.empty()) {
+            runSweep(prob, solSys);
+            solSys -> report();
+            return 0;
+        }
+        if (prob.hasReaction()) {
+            solSys -> assembleStiff();
+            solSys -> solveNonlinear();
+            solSys -> output();
+            solSys -> report();
+            return 0;
+        }
+        if (prob.parameters.timeSteps > 0) {
+            solSys -> assembleStiff();
+            solSys -> solveTransient();
+            solSys -> output();
+            solSys -> report();
+            return 0;
+        }
+        
         solSys -> assembleStiff();
         solSys -> solveSparse();
+        
+        // solve, estimate, mark and refine until the cycles are used up or the estimate is below adaptiveTol
+        int cycle = 0;
+        while (cycle < prob.parameters.nAdaptive && solSys -> refineAdaptive(prob.parameters.nRefine + cycle)) {
+            solSys -> assembleStiff(); // only the refined region is reassembled
+            solSys -> solveSparse();
+            cycle++;
+        }
+        RunReport::setValue("adaptive_cycles", cycle);
         solSys -> output();
+        solSys -> report();
         
     } catch (std::runtime_error &e) {
         cout << e.what() << endl;
@@ -0,0 +1,349 @@
+//
+//  mainbench.cpp
+//  tri
+//
+//  Microbenchmarks of the assembly and conversion kernels on square
+// meshes generated in process. Results are written as JSON, one
+// benchmark per line, and can be compared with a stored baseline.
+//
+//  ./tribench [-o out.json] [-c baseline.json] [-t tolerance] [-n maxN]
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include "mesh.h"
+#include "DGSolvingSystem.h"
+#include "DGProblem.h"
+
+using namespace std;
+
+// expose the kernels of DGSolvingSystem
+class BenchSolvingSystem: public DGSolvingSystem {
+public:
+    BenchSolvingSystem(Mesh *m, Problem *p): DGSolvingSystem(m, p)
+    {
+        dof = retrieve_dof_count_element_dofIndex(*mesh);
+        x.assign(dof, 1.0);
+        rh = new double [dof]();
+        ma.resize(dof);
+        updateVertexValues();
+        computeGeometry();
+    }
+    using DGSolvingSystem::elementInteg;
+    using DGSolvingSystem::edgeInteg;
+    using DGSolvingSystem::computeGeometry;
+    using DGSolvingSystem::assembleElements;
+    using DGSolvingSystem::assembleEdges;
+    using DGSolvingSystem::elementLanes;
+    using DGSolvingSystem::interiorLanes;
+    using DGSolvingSystem::boundaryLanes;
+    using DGSolvingSystem::addToMA;
+    using DGSolvingSystem::computeError;
+    using DGSolvingSystem::ma;
+    using DGSolvingSystem::dof;
+};
+
+// only converts to CSC in its constructor
+class BenchLinearSolver: public LinearSolver {
+public:
+    BenchLinearSolver(vector< list<maColEle> > &ma, int dof, double *rh): LinearSolver(ma, dof, rh) {}
+    vector<double> solveSparse() { return vector<double>(); }
+};
+
+struct BenchResult {
+    string name;
+    int n;           // squares per side of the mesh
+    long items;      // entities processed per repetition
+    double nsPerItem;
+    long reps;
+};
+
+// run kernel until at least 20ms have passed, keep the best of 5 samples
+template <typename F>
+BenchResult measure(const string &name, int n, long items, F kernel)
+{
+    typedef chrono::steady_clock clock;
+    kernel(); // warm up
+
+    long reps = 1;
+    double best = 1e300;
+    for (int sample = 0; sample < 5; ++sample) {
+        double seconds;
+        while (true) {
+            clock::time_point start = clock::now();
+            for (long r = 0; r < reps; ++r)
+                kernel();
+            seconds = chrono::duration<double>(clock::now() - start).count();
+            if (seconds >= 0.02 || sample > 0)
+                break;
+            reps *= 2;
+        }
+        best = min(best, seconds / reps);
+    }
+
+    BenchResult res = {name, n, items, best / max(items, 1L) * 1e9, reps};
+    cout << "  " << name << " n = " << n << ": " << res.nsPerItem << " ns per item" << endl;
+    return res;
+}
+
+// an interior edge is hanging if one of its elements does not have both of its vertices
+bool isHanging(Mesh &mesh, Edge &ed)
+{
+    for (int e : ed.neighborElement) {
+        vector<int> &ver = mesh.element[e - 1].vertex;
+        if (std::find(ver.begin(), ver.end(), ed.vertex[0]) == ver.end()
+            || std::find(ver.begin(), ver.end(), ed.vertex[1]) == ver.end())
+            return true;
+    }
+    return false;
+}
+
+void benchMesh(int n, Problem &prob, vector<BenchResult> &results)
+{
+    // meshgen n + 1 3 3, the second with the squares along the boundary refined into four
+    Mesh mesh;
+    mesh.generateSquare(n + 1, 3, 3, 0);
+
+    Mesh hangingMesh;
+    hangingMesh.generateSquare(n + 1, 3, 3, 1);
+
+    // connectivity of the unrefined mesh
+    results.push_back(measure("findElementEdge", n, mesh.element.size(), [&mesh]() {
+        for (Element &ele : mesh.element)
+            ele.edge.clear();
+        for (Edge &ed : mesh.edge)
+            ed.neighborElement.clear();
+        mesh.findElementEdge(0);
+    }));
+
+    hangingMesh.calcDetBE();
+    BenchSolvingSystem sys(&hangingMesh, &prob);
+
+    vector<Element *> leaves;
+    for (Element &ele : hangingMesh.element)
+        if (ele.reftype == constNonrefined)
+            leaves.push_back(&ele);
+    vector<Edge *> conforming, hanging, boundary;
+    for (Edge &ed : hangingMesh.edge) {
+        if (ed.reftype != constNonrefined)
+            continue;
+        if (ed.neighborElement.size() == 1)
+            boundary.push_back(&ed);
+        else if (isHanging(hangingMesh, ed))
+            hanging.push_back(&ed);
+        else
+            conforming.push_back(&ed);
+    }
+
+    vector<int> leafIndex, leafEdgeIndex;
+    for (Element *ele : leaves)
+        leafIndex.push_back(ele -> index);
+    for (Edge &ed : hangingMesh.edge)
+        if (ed.reftype == constNonrefined)
+            leafEdgeIndex.push_back(ed.index);
+    results.push_back(measure("computeGeometry", n, leafIndex.size() + leafEdgeIndex.size(), [&]() {
+        sys.computeGeometry(leafIndex, leafEdgeIndex);
+    }));
+
+    double checksum = 0;
+    results.push_back(measure("elementInteg", n, leaves.size(), [&]() {
+        for (Element *ele : leaves)
+            checksum += sys.elementInteg(*ele)[0][0];
+    }));
+
+    VECMATRIX M11, M12, M21, M22;
+    vector<double> rhs;
+    results.push_back(measure("edgeInteg_conforming", n, conforming.size(), [&]() {
+        for (Edge *ed : conforming) {
+            sys.edgeInteg(*ed, M11, M12, M21, M22);
+            checksum += M12[0][0];
+        }
+    }));
+    results.push_back(measure("edgeInteg_hanging", n, hanging.size(), [&]() {
+        for (Edge *ed : hanging) {
+            sys.edgeInteg(*ed, M11, M12, M21, M22);
+            checksum += M12[0][0];
+        }
+    }));
+    results.push_back(measure("edgeInteg_boundary", n, boundary.size(), [&]() {
+        for (Edge *ed : boundary) {
+            sys.edgeInteg(*ed, M11, rhs);
+            checksum += rhs[0];
+        }
+    }));
+
+    // the batched kernels on the last batch of a full assembly, TRI_SIMD picks the width
+    sys.assembleElements(leafIndex);
+    sys.assembleEdges(leafEdgeIndex);
+    const SimdKernels &kernels = simdKernels();
+    results.push_back(measure("elementBlocks", n, sys.elementLanes.n, [&]() {
+        kernels.elementBlocks(sys.elementLanes);
+        checksum += sys.elementLanes.K[0][0][0];
+    }));
+    results.push_back(measure("interiorEdgeBlocks", n, sys.interiorLanes.n, [&]() {
+        kernels.interiorEdgeBlocks(sys.interiorLanes, prob.epsilon, prob.sigma0 / 6.0);
+        checksum += sys.interiorLanes.M[1][0][0][0];
+    }));
+    results.push_back(measure("boundaryEdgeBlocks", n, sys.boundaryLanes.n, [&]() {
+        kernels.boundaryEdgeBlocks(sys.boundaryLanes, prob.epsilon, prob.sigma0 / 6.0);
+        checksum += sys.boundaryLanes.M[0][0][0][0];
+    }));
+
+    // the entries of a full assembly, in assembly order
+    struct Entry { double value; int row, col; };
+    vector<Entry> entries;
+    for (Element *ele : leaves) {
+        VECMATRIX M = sys.elementInteg(*ele);
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c)
+                entries.push_back(Entry {M[r][c], ele -> dofIndex + r, ele -> dofIndex + c});
+    }
+    for (Edge &ed : hangingMesh.edge) {
+        if (ed.reftype != constNonrefined)
+            continue;
+        Element &E1 = hangingMesh.element[ed.neighborElement[0] - 1];
+        if (ed.neighborElement.size() == 1) {
+            sys.edgeInteg(ed, M11, rhs);
+            for (int r = 0; r < 3; ++r)
+                for (int c = 0; c < 3; ++c)
+                    entries.push_back(Entry {M11[r][c], E1.dofIndex + r, E1.dofIndex + c});
+            continue;
+        }
+        Element &E2 = hangingMesh.element[ed.neighborElement[1] - 1];
+        sys.edgeInteg(ed, M11, M12, M21, M22);
+        for (int r = 0; r < 3; ++r)
+            for (int c = 0; c < 3; ++c) {
+                entries.push_back(Entry {M11[r][c], E1.dofIndex + r, E1.dofIndex + c});
+                entries.push_back(Entry {M12[r][c], E1.dofIndex + r, E2.dofIndex + c});
+                entries.push_back(Entry {M21[r][c], E2.dofIndex + r, E1.dofIndex + c});
+                entries.push_back(Entry {M22[r][c], E2.dofIndex + r, E2.dofIndex + c});
+            }
+    }
+
+    results.push_back(measure("addToMA", n, entries.size(), [&]() {
+        for (auto &col : sys.ma)
+            col.clear();
+        for (Entry &e : entries)
+            sys.addToMA(e.value, e.row, e.col);
+    }));
+
+    // CSC conversion of the assembled matrix, quiet since it reports to the console
+    vector<double> rh(sys.dof, 1.0);
+    long nnz = 0;
+    for (auto &col : sys.ma)
+        nnz += col.size();
+    cout.setstate(ios::failbit);
+    BenchResult csc = measure("cscConversion", n, nnz, [&]() {
+        BenchLinearSolver ls(sys.ma, sys.dof, rh.data());
+    });
+    cout.clear();
+    cout << "  cscConversion n = " << n << ": " << csc.nsPerItem << " ns per item" << endl;
+    results.push_back(csc);
+
+    results.push_back(measure("computeError", n, leaves.size(), [&]() {
+        double errL2, errH1;
+        sys.computeError(errL2, errH1);
+        checksum += errL2;
+    }));
+
+    if (checksum == 0.123456789)
+        cout << checksum << endl;
+}
+
+void writeResults(const string &filename, vector<BenchResult> &results)
+{
+    ofstream fout(filename.c_str());
+    fout << "[\n";
+    for (vector<BenchResult>::size_type i = 0; i < results.size(); ++i)
+        fout << "  {\"name\": \"" << results[i].name << "\", \"n\": " << results[i].n
+             << ", \"items\": " << results[i].items << ", \"ns_per_item\": " << results[i].nsPerItem
+             << ", \"reps\": " << results[i].reps << "}" << (i + 1 < results.size() ? ",\n" : "\n");
+    fout << "]\n";
+    cout << "results written to " << filename << endl;
+}
+
+vector<BenchResult> readResults(const string &filename)
+{
+    ifstream fin(filename.c_str());
+    if (!fin)
+        throw runtime_error("error opening " + filename);
+
+    vector<BenchResult> results;
+    string line;
+    char name[128];
+    while (getline(fin, line)) {
+        BenchResult res;
+        if (sscanf(line.c_str(), " {\"name\": \"%127[^\"]\", \"n\": %d, \"items\": %ld, \"ns_per_item\": %lf, \"reps\": %ld",
+                   name, &res.n, &res.items, &res.nsPerItem, &res.reps) == 5) {
+            res.name = name;
+            results.push_back(res);
+        }
+    }
+    return results;
+}
+
+// print current / baseline for each benchmark, return the number of regressions
+int compareResults(vector<BenchResult> &baseline, vector<BenchResult> &results, double tolerance)
+{
+    int regressions = 0;
+    cout << endl << "benchmark\tn\tbaseline\tcurrent\tratio" << endl;
+    for (BenchResult &res : results)
+        for (BenchResult &base : baseline) {
+            if (base.name != res.name || base.n != res.n)
+                continue;
+            double ratio = res.nsPerItem / base.nsPerItem;
+            cout << res.name << "\t" << res.n << "\t" << base.nsPerItem << "\t" << res.nsPerItem << "\t" << ratio;
+            if (ratio > 1 + tolerance) {
+                cout << "\tslower";
+                ++regressions;
+            } else if (ratio < 1 - tolerance)
+                cout << "\tfaster";
+            cout << endl;
+        }
+    return regressions;
+}
+
+int main(int argc, const char * argv[]) {
+    string outFile = "bench.json", baselineFile;
+    double tolerance = 0.1;
+    int maxN = 64;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        string opt = argv[i];
+        if (opt == "-o")
+            outFile = argv[i + 1];
+        else if (opt == "-c")
+            baselineFile = argv[i + 1];
+        else if (opt == "-t")
+            tolerance = atof(argv[i + 1]);
+        else if (opt == "-n")
+            maxN = atoi(argv[i + 1]);
+    }
+
+    try {
+        StaticProblem<QuadraticCoeff> prob((DGProblem())); // the default problem of tri
+        prob.parameters.meshFilename = "bench";
+
+        vector<BenchResult> results;
+        cout << "element and edge kernels: " << simdKernels().name << endl;
+        for (int n = 8; n <= maxN; n *= 2) {
+            cout << "mesh with " << n << " x " << n << " squares" << endl;
+            benchMesh(n, prob, results);
+        }
+        writeResults(outFile, results);
+
+        if (!baselineFile.empty()) {
+            vector<BenchResult> baseline = readResults(baselineFile);
+            if (compareResults(baseline, results, tolerance) > 0)
+                return 1;
+        }
+    } catch (std::runtime_error &e) {
+        cout << e.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -21,17 +21,42 @@ int main(int argc, const char *argv[])
     try
     {
         MPI_Init(NULL, NULL);
-        int nprow = 2, npcol = 2;
+
+        // the most square nprow x npcol grid of all processors
+        int world_size;
+        MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+        int nprow = (int) sqrt((double) world_size);
+        while (world_size % nprow != 0)
+            --nprow;
+        int npcol = world_size / nprow;
 
         superlu_gridinit(MPI_COMM_WORLD, nprow, npcol, &grid);
 
-        DGProblem prob(argc, argv);
+        DGProblem input(argc, argv);
+        std::unique_ptr<Problem> problem = createProblem(input);
+        Problem &prob = *problem;
         Mesh mesh(&prob);
 
+        if (prob.hasReaction())
+            throw std::runtime_error("problems with a reaction term are not supported by trimpi");
+        // the features of tri that trimpi leaves out, noted once
+        if (grid.iam == 0) {
+            if (prob.parameters.hybridized)
+                std::cout << "hybridized DG is not supported by trimpi, using SIPG" << std::endl;
+            if (prob.parameters.timeSteps > 0)
+                std::cout << "time stepping is not supported by trimpi, solving the steady problem" << std::endl;
+            if (!prob.parameters.sweep.empty())
+                std::cout << "parameter sweeps are not supported by trimpi, solving the case of the input parameters" << std::endl;
+            if (prob.parameters.nAdaptive > 0)
+                std::cout << "adaptive refinement is not supported by trimpi, solving on the initial mesh" << std::endl;
+            if (prob.parameters.stagingMB > 0)
+                std::cout << "out-of-core assembly is not supported by trimpi, assembling in memory" << std::endl;
+        }
         BasicSolvingSystem *solSys = new DGSolvingSystemMPI(&mesh, &prob, &grid);
         solSys -> assembleStiff();
         solSys -> solveSparse();
         solSys -> output();
+        solSys -> report();
 
         superlu_gridexit(&grid);
         MPI_Finalize();
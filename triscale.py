@@ -0,0 +1,166 @@
+# Strong and weak scaling of tri and trimpi on one machine.
+# tri and trimpi generate the square meshes of meshgen in memory, tri
+# runs over the thread counts and trimpi over the rank counts with
+# mpiexec; the phase times,
+# peak RSS, nnz and factor fill are read from *.report.json.
+
+from __future__ import print_function
+
+import os
+import json
+import math
+import time
+import argparse
+import subprocess
+
+__author__ = 'gbb'
+
+PHASES = ['mesh_generation', 'connectivity', 'refinement', 'geometry', 'element_assembly', 'edge_assembly', 'csc_conversion',
+          'symbolic_factorization', 'numeric_factorization', 'solve', 'error_computation', 'output']
+
+INPUT = """square {n} 3 3  # square mesh of meshgen N 3 3 generated in memory
+2              # dimension
+1              # epsilon
+10             # sigma0
+1              # beta0   // for now only deal with beta0 = 1
+{refine}              # refinement times
+
+{solpack}              # solving package, 0 for "UMFPACK", 1 for "SuperLU" and 2 for "SuperLU_DIST"
+0              # print mesh info in console
+1              # compute and print error
+0              # output results in console
+0              # file output results, *.output
+0              # file output stiff matrix in compressed column form, *.ma
+0              # file output righ-hand side matrix, *.rh
+0              # file output stiff matrix in triplet form, *.triplet
+1              # file output run report in JSON, *.report.json
+"""
+
+
+def parse_options():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--sizes', type=int, nargs='*', default=[11, 21, 41],
+                        help='meshgen N of the strong scaling meshes')
+    parser.add_argument('--weak-base', type=int, default=11,
+                        help='meshgen N of the weak scaling mesh on one rank')
+    parser.add_argument('--ranks', type=int, nargs='*', default=[1, 2, 4])
+    parser.add_argument('--threads', type=int, nargs='*', default=[1])
+    parser.add_argument('--refine', type=int, default=0, help='refinement times')
+    parser.add_argument('--reps', type=int, default=1, help='runs per case, the fastest is kept')
+    parser.add_argument('--mpiexec', default='mpiexec')
+    parser.add_argument('--no-tri', action='store_true')
+    parser.add_argument('--no-trimpi', action='store_true')
+    parser.add_argument('--workdir', default='scaling')
+    return parser.parse_args()
+
+
+def path_of(name):
+    return os.path.join(os.path.dirname(os.path.realpath(__file__)), name)
+
+
+def prepare_mesh(args, n):
+    meshdir = os.path.join(args.workdir, 'N' + str(n))
+    if not os.path.isdir(meshdir):
+        os.makedirs(meshdir)
+    for solpack in [0, 2]:
+        with open(os.path.join(meshdir, 'tri%d.input' % solpack), 'w') as f:
+            f.write(INPUT.format(n=n, refine=args.refine, solpack=solpack))
+    return meshdir
+
+
+def run_case(args, meshdir, binary, ranks, threads):
+    env = dict(os.environ)
+    for var in ['OMP_NUM_THREADS', 'OPENBLAS_NUM_THREADS', 'MKL_NUM_THREADS', 'VECLIB_MAXIMUM_THREADS']:
+        env[var] = str(threads)
+
+    if binary == 'tri':
+        cmd = [path_of('tri'), 'tri0.input']
+    else:
+        cmd = args.mpiexec.split() + ['-np', str(ranks), path_of('trimpi'), 'tri2.input']
+
+    best = None
+    for rep in range(args.reps):
+        report_file = os.path.join(meshdir, 'square_%s_3_3.report.json' % os.path.basename(meshdir)[1:])
+        if os.path.isfile(report_file):
+            os.remove(report_file)
+        start = time.time()
+        with open(os.path.join(meshdir, binary + '.log'), 'w') as log:
+            ret = subprocess.call(cmd, cwd=meshdir, env=env, stdout=log, stderr=subprocess.STDOUT)
+        wall = time.time() - start
+        if ret != 0 or not os.path.isfile(report_file):
+            print('  failed: ' + ' '.join(cmd) + ', see ' + os.path.join(meshdir, binary + '.log'))
+            return None
+        with open(report_file) as f:
+            report = json.load(f)
+        if best is None or wall < best['wall']:
+            best = {'wall': wall, 'report': report}
+
+    values = best['report']['values']
+    phases = dict((p['name'], p['max']) for p in best['report']['phases'])
+    record = {'binary': binary, 'mesh': os.path.basename(meshdir), 'ranks': ranks, 'threads': threads,
+              'wall': best['wall'], 'dof': int(values.get('dof') or 0), 'nnz': int(values.get('nnz') or 0),
+              'factor_nnz': int(values.get('factor_nnz') or 0), 'peak_rss_kb': int(values.get('peak_rss_kb') or 0),
+              'phases': phases}
+    record['fill'] = float(record['factor_nnz']) / record['nnz'] if record['nnz'] and record['factor_nnz'] else 0
+    print('  %s N=%s ranks=%d threads=%d: %.3fs' % (binary, record['mesh'][1:], ranks, threads, record['wall']))
+    return record
+
+
+def print_table(title, records, base_wall, weak):
+    print('\n' + title)
+    header = ['ranks', 'threads', 'dof', 'wall', 'speedup', 'efficiency', 'rss_mb', 'nnz', 'fill'] + PHASES
+    print('\t'.join(header))
+    for r in records:
+        # weak scaling is ideal at constant time, strong scaling at time / workers
+        speedup = base_wall / r['wall']
+        efficiency = speedup if weak else speedup / (r['ranks'] * r['threads'])
+        row = [str(r['ranks']), str(r['threads']), str(r['dof']), '%.3f' % r['wall'], '%.2f' % speedup,
+               '%.2f' % efficiency, '%.1f' % (r['peak_rss_kb'] / 1024.0), str(r['nnz']), '%.2f' % r['fill']]
+        row += ['%.4f' % r['phases'].get(p, 0) for p in PHASES]
+        print('\t'.join(row))
+
+
+#  here it starts
+args = parse_options()
+if not os.path.isdir(args.workdir):
+    os.makedirs(args.workdir)
+
+binaries = [b for b in ['tri', 'trimpi'] if not (b == 'tri' and args.no_tri) and not (b == 'trimpi' and args.no_trimpi)]
+records = []
+
+#  strong scaling: the same mesh on more ranks or threads
+print('strong scaling')
+for n in args.sizes:
+    meshdir = prepare_mesh(args, n)
+    for binary in binaries:
+        rank_list = [1] if binary == 'tri' else args.ranks
+        case = []
+        for ranks in rank_list:
+            for threads in args.threads:
+                r = run_case(args, meshdir, binary, ranks, threads)
+                if r is not None:
+                    case.append(r)
+        if case:
+            print_table('strong scaling, %s, N = %d' % (binary, n), case, case[0]['wall'], False)
+            for r in case:
+                r['study'] = 'strong'
+            records += case
+
+#  weak scaling: about the same number of elements per rank, 2 (N - 1)^2 elements in total
+if 'trimpi' in binaries:
+    print('\nweak scaling')
+    case = []
+    for ranks in args.ranks:
+        n = int(round(1 + (args.weak_base - 1) * math.sqrt(ranks)))
+        meshdir = prepare_mesh(args, n)
+        r = run_case(args, meshdir, 'trimpi', ranks, args.threads[0])
+        if r is not None:
+            r['study'] = 'weak'
+            case.append(r)
+    if case:
+        print_table('weak scaling, trimpi, N = %d per rank' % args.weak_base, case, case[0]['wall'], True)
+        records += case
+
+with open(os.path.join(args.workdir, 'scaling.json'), 'w') as f:
+    json.dump(records, f, indent=1)
+print('\nall results written to ' + os.path.join(args.workdir, 'scaling.json'))